@@ -0,0 +1,318 @@
+#include "cgen.h"
+#include "Chunk/chunk.h"
+#include "Core/object.h"
+#include "Core/value.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+// Runtime support emitted ahead of the generated function. It mirrors
+// run() in VM/vm.c so compiled scripts keep interpreter semantics.
+static const char *prelude =
+"#include \"common.h\"\n"
+"#include \"Core/array.h\"\n"
+"#include \"Core/memory.h\"\n"
+"#include \"Core/object.h\"\n"
+"#include \"Core/output.h\"\n"
+"#include \"Core/sequence.h\"\n"
+"#include \"Core/value.h\"\n"
+"#include \"VM/vm.h\"\n"
+"\n"
+"#include <stdlib.h>\n"
+"#include <string.h>\n"
+"\n"
+"VM vm;\n"
+"\n"
+"static void loxError(const char *message, int line) {\n"
+"    flushOutput();\n"
+"    fprintf(stderr, \"%s\\n[line %d] in script\\n\", message, line);\n"
+"    freeObjects();\n"
+"    exit(70);\n"
+"}\n"
+"\n"
+"typedef const char *(*LoxArrayUnary)(Value, Value*);\n"
+"typedef const char *(*LoxArrayBinary)(Value, Value, Value*);\n"
+"\n"
+"static Value loxArrayUnary(LoxArrayUnary op, Value a, int line) {\n"
+"    Value result;\n"
+"    const char *error = op(a, &result);\n"
+"    if (error != NULL) loxError(error, line);\n"
+"    return result;\n"
+"}\n"
+"\n"
+"static Value loxArrayBinary(LoxArrayBinary op, Value a, Value b,\n"
+"                            int line) {\n"
+"    Value result;\n"
+"    const char *error = op(a, b, &result);\n"
+"    if (error != NULL) loxError(error, line);\n"
+"    return result;\n"
+"}\n"
+"\n"
+"static Value loxDot(Value a, Value b, int line) {\n"
+"    return loxArrayBinary(arrayDot, a, b, line);\n"
+"}\n"
+"\n"
+"static Value loxIndex(Value a, Value b, int line) {\n"
+"    return loxArrayBinary(sequenceIndex, a, b, line);\n"
+"}\n"
+"\n"
+"static inline void loxCheckNumbers(Value a, Value b, int line) {\n"
+"    if (!IS_NUMBER(a) || !IS_NUMBER(b))\n"
+"        loxError(\"Operands must be numbers.\", line);\n"
+"}\n"
+"\n"
+"static inline Value loxAdd(Value a, Value b, int line) {\n"
+"    int64_t result;\n"
+"    if (IS_INT(a) && IS_INT(b) &&\n"
+"        !__builtin_add_overflow(AS_INT(a), AS_INT(b), &result))\n"
+"        return MAKE_INT_VAL(result);\n"
+"    if (IS_STRING(a) && IS_STRING(b))\n"
+"        return MAKE_OBJ_VAL(concatenateStrings(AS_STRING(a), AS_STRING(b)));\n"
+"    if (isArrayArithmetic(a, b))\n"
+"        return loxArrayBinary(arrayAdd, a, b, line);\n"
+"    if (!IS_NUMBER(a) || !IS_NUMBER(b))\n"
+"        loxError(\"Operands must be two numbers or two strings.\", line);\n"
+"    return MAKE_NUMBER_VAL(AS_NUMBER(a) + AS_NUMBER(b));\n"
+"}\n"
+"\n"
+"static inline Value loxSubtract(Value a, Value b, int line) {\n"
+"    int64_t result;\n"
+"    loxCheckNumbers(a, b, line);\n"
+"    if (IS_INT(a) && IS_INT(b) &&\n"
+"        !__builtin_sub_overflow(AS_INT(a), AS_INT(b), &result))\n"
+"        return MAKE_INT_VAL(result);\n"
+"    return MAKE_NUMBER_VAL(AS_NUMBER(a) - AS_NUMBER(b));\n"
+"}\n"
+"\n"
+"static inline Value loxMultiply(Value a, Value b, int line) {\n"
+"    int64_t result;\n"
+"    if (isArrayArithmetic(a, b))\n"
+"        return loxArrayBinary(arrayMultiply, a, b, line);\n"
+"    loxCheckNumbers(a, b, line);\n"
+"    if (IS_INT(a) && IS_INT(b) &&\n"
+"        !intMultiplyOverflow(AS_INT(a), AS_INT(b), &result))\n"
+"        return MAKE_INT_VAL(result);\n"
+"    return MAKE_NUMBER_VAL(AS_NUMBER(a) * AS_NUMBER(b));\n"
+"}\n"
+"\n"
+"static inline Value loxDivide(Value a, Value b, int line) {\n"
+"    loxCheckNumbers(a, b, line);\n"
+"    return MAKE_NUMBER_VAL(AS_NUMBER(a) / AS_NUMBER(b));\n"
+"}\n"
+"\n"
+"static inline Value loxLess(Value a, Value b, int line) {\n"
+"    loxCheckNumbers(a, b, line);\n"
+"    if (IS_INT(a) && IS_INT(b))\n"
+"        return MAKE_BOOL_VAL(AS_INT(a) < AS_INT(b));\n"
+"    return MAKE_BOOL_VAL(AS_NUMBER(a) < AS_NUMBER(b));\n"
+"}\n"
+"\n"
+"static inline Value loxGreater(Value a, Value b, int line) {\n"
+"    loxCheckNumbers(a, b, line);\n"
+"    if (IS_INT(a) && IS_INT(b))\n"
+"        return MAKE_BOOL_VAL(AS_INT(a) > AS_INT(b));\n"
+"    return MAKE_BOOL_VAL(AS_NUMBER(a) > AS_NUMBER(b));\n"
+"}\n"
+"\n"
+"static inline Value loxNot(Value a) {\n"
+"    return MAKE_BOOL_VAL(IS_NIL(a) || (IS_BOOL(a) && !AS_BOOL(a)));\n"
+"}\n"
+"\n"
+"static inline Value loxNegate(Value a, int line) {\n"
+"    if (!IS_NUMBER(a))\n"
+"        loxError(\"Operand must be a number.\", line);\n"
+"    if (IS_INT(a) && AS_INT(a) != 0 && AS_INT(a) != INT64_MIN)\n"
+"        return MAKE_INT_VAL(-AS_INT(a));\n"
+"    return MAKE_NUMBER_VAL(-AS_NUMBER(a));\n"
+"}\n"
+"\n";
+
+// Writes chars as a C string literal; octal escapes keep any byte safe
+static void emitStringLiteral(FILE *out, const char *chars, int length) {
+    fputc('"', out);
+    for (int i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)chars[i];
+        if (c == '"' || c == '\\' || c == '?') {
+            fprintf(out, "\\%c", c);
+        }
+        else if (c < 0x20 || c >= 0x7F) {
+            fprintf(out, "\\%03o", c);
+        }
+        else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void emitArray(FILE *out, ObjArray *array) {
+    if (array->count == 0) {
+        fprintf(out, "MAKE_OBJ_VAL(copyArray(NULL, 0))");
+        return;
+    }
+
+    fprintf(out, "MAKE_OBJ_VAL(copyArray((const double[]){");
+    for (int i = 0; i < array->count; i++)
+        fprintf(out, "%s%a", i > 0 ? ", " : "", array->values[i]);
+    fprintf(out, "}, %d))", array->count);
+}
+
+static void emitValue(FILE *out, Value value) {
+    switch (value.type) {
+        case VAL_BOOL:
+            fprintf(out, "MAKE_BOOL_VAL(%s)",
+                    AS_BOOL(value) ? "true" : "false");
+            break;
+        case VAL_NIL: fprintf(out, "MAKE_NIL_VAL"); break;
+        case VAL_NUMBER:
+            // %a is exact, so the constant round-trips bit for bit
+            fprintf(out, "MAKE_NUMBER_VAL(%a)", AS_DOUBLE(value));
+            break;
+        case VAL_INT:
+            fprintf(out, "MAKE_INT_VAL(INT64_C(%" PRId64 "))",
+                    AS_INT(value));
+            break;
+        case VAL_OBJ:
+            if (IS_ARRAY(value)) {
+                emitArray(out, AS_ARRAY(value));
+                break;
+            }
+
+            ObjString *string = AS_STRING(value);
+            fprintf(out, "MAKE_OBJ_VAL(copyString(");
+            emitStringLiteral(out, string->chars, string->length);
+            fprintf(out, ", %d))", string->length);
+            break;
+    }
+}
+
+static const char *binaryHelper(uint8_t instruction) {
+    switch (instruction) {
+        // Unchecked forms share the helpers, the C compiler drops the
+        // checks it can prove redundant
+        case OP_ADD:
+        case OP_ADD_NN:
+        case OP_CONCAT:
+            return "loxAdd";
+        case OP_SUBTRACT:
+        case OP_SUBTRACT_NN:
+            return "loxSubtract";
+        case OP_MULTIPLY:
+        case OP_MULTIPLY_NN:
+            return "loxMultiply";
+        case OP_DIVIDE:
+        case OP_DIVIDE_NN:
+            return "loxDivide";
+        case OP_LESS:
+        case OP_LESS_NN:
+            return "loxLess";
+        case OP_GREATER:
+        case OP_GREATER_NN:
+            return "loxGreater";
+        case OP_DOT: return "loxDot";
+        case OP_INDEX: return "loxIndex";
+        default: return NULL;
+    }
+}
+
+static const char *arrayFunction(uint8_t instruction) {
+    switch (instruction) {
+        case OP_SUM: return "arraySum";
+        case OP_MIN: return "arrayMin";
+        case OP_MAX: return "arrayMax";
+        case OP_LENGTH: return "sequenceLength";
+        default: return "arrayRange";
+    }
+}
+
+bool emitC(Chunk *chunk, const char *scriptName, FILE *out) {
+    // The code is straight-line, so each stack slot maps to one local
+    int maxDepth = chunk->stackDepth;
+
+    fprintf(out, "// Generated by clox --emit-c from %s\n", scriptName);
+    fputs(prelude, out);
+    fprintf(out, "int main(void) {\n");
+    for (int slot = 0; slot < maxDepth; slot++)
+        fprintf(out, "    Value s%d;\n", slot);
+    fprintf(out, "\n");
+    fprintf(out, "    initOutput(&vm.output, OUTPUT_BUFFER_DEFAULT);\n");
+
+    int depth = 0;
+    for (int offset = 0; offset < chunk->count;
+         offset += instructionSize(chunk, offset))
+    {
+        uint8_t instruction = chunk->code[offset];
+        int line = chunk->lines[offset];
+        int top = depth - 1;
+
+        switch (instruction) {
+            case OP_CONSTANT:
+                fprintf(out, "    s%d = ", depth);
+                emitValue(out, chunk->constants.values[chunk->code[offset + 1]]);
+                fprintf(out, ";\n");
+                break;
+            case OP_NIL:
+                fprintf(out, "    s%d = MAKE_NIL_VAL;\n", depth);
+                break;
+            case OP_GET_LOCAL:
+                fprintf(out, "    s%d = s%d;\n",
+                        depth, chunk->code[offset + 1]);
+                break;
+            case OP_SET_LOCAL:
+                fprintf(out, "    s%d = s%d;\n",
+                        chunk->code[offset + 1], top);
+                break;
+            case OP_TRUE:
+                fprintf(out, "    s%d = MAKE_BOOL_VAL(true);\n", depth);
+                break;
+            case OP_FALSE:
+                fprintf(out, "    s%d = MAKE_BOOL_VAL(false);\n", depth);
+                break;
+            case OP_EQUAL:
+                fprintf(out, "    s%d = MAKE_BOOL_VAL(valuesEqual(s%d, s%d));\n",
+                        top - 1, top - 1, top);
+                break;
+            case OP_NOT:
+                fprintf(out, "    s%d = loxNot(s%d);\n", top, top);
+                break;
+            case OP_NEGATE:
+            case OP_NEGATE_N:
+                fprintf(out, "    s%d = loxNegate(s%d, %d);\n",
+                        top, top, line);
+                break;
+            case OP_SUM:
+            case OP_MIN:
+            case OP_MAX:
+            case OP_RANGE:
+            case OP_LENGTH:
+                fprintf(out, "    s%d = loxArrayUnary(%s, s%d, %d);\n",
+                        top, arrayFunction(instruction), top, line);
+                break;
+            case OP_RETURN:
+                fprintf(out, "    printValue(s%d);\n", top);
+                fprintf(out, "    writeOutput(\"\\n\", 1);\n");
+                fprintf(out, "    freeOutput(&vm.output);\n");
+                fprintf(out, "    freeObjects();\n");
+                fprintf(out, "    return 0;\n");
+                break;
+            default: {
+                const char *helper = binaryHelper(instruction);
+                if (helper == NULL) {
+                    fprintf(stderr, "Cannot emit C for opcode %d.\n",
+                            instruction);
+
+                    return false;
+                }
+
+                fprintf(out, "    s%d = %s(s%d, s%d, %d);\n",
+                        top - 1, helper, top - 1, top, line);
+                break;
+            }
+        }
+
+        depth += stackEffect(chunk, offset);
+    }
+
+    fprintf(out, "}\n");
+    return true;
+}
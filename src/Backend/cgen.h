@@ -0,0 +1,8 @@
+#pragma once
+
+#include "Chunk/chunk.h"
+#include "common.h"
+
+// Writes a standalone C translation unit equivalent to chunk, to be
+// linked against the Core runtime. Returns false on unsupported code.
+bool emitC(Chunk *chunk, const char *scriptName, FILE *out);
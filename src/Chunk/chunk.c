@@ -10,6 +10,8 @@ void initChunk(Chunk *chunk) {
     chunk->code = NULL;
     chunk->lines = NULL;
     initValueArray(&chunk->constants);
+    chunk->frozen = false;
+    chunk->stackDepth = 0;
 }
 
 void writeChunk(Chunk *chunk, uint8_t byte, int line) {
@@ -21,13 +23,15 @@ void writeChunk(Chunk *chunk, uint8_t byte, int line) {
             uint8_t,
             chunk->code,
             oldCapacity, 
-            chunk->capacity
+            chunk->capacity,
+            MEM_CHUNK
         );
         chunk->lines = GROW_ARRAY( 
             int,
             chunk->lines,
             oldCapacity, 
-            chunk->capacity
+            chunk->capacity,
+            MEM_CHUNK
         );
     }
     
@@ -44,8 +48,50 @@ int addConstant(Chunk *chunk, Value value) {
 }
 
 void freeChunk(Chunk *chunk) {
-    FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
-    FREE_ARRAY(int, chunk->lines, chunk->capacity);
+    // Whoever holds a frozen chunk only forgets it
+    if (chunk->frozen) {
+        initChunk(chunk);
+        return;
+    }
+
+    FREE_ARRAY(uint8_t, chunk->code, chunk->capacity, MEM_CHUNK);
+    FREE_ARRAY(int, chunk->lines, chunk->capacity, MEM_CHUNK);
     freeValueArray(&chunk->constants);
     initChunk(chunk);
 }
+
+int instructionSize(Chunk *chunk, int offset) {
+    switch (chunk->code[offset]) {
+        case OP_CONSTANT:
+        case OP_GET_LOCAL:
+        case OP_SET_LOCAL:
+        case OP_COLUMN:
+            return 2;
+        default: return 1;
+    }
+}
+
+int stackEffect(Chunk *chunk, int offset) {
+    switch (chunk->code[offset]) {
+        case OP_CONSTANT:
+        case OP_NIL:
+        case OP_TRUE:
+        case OP_FALSE:
+        case OP_GET_LOCAL:
+        case OP_COLUMN:
+            return 1;
+        case OP_NOT:
+        case OP_NEGATE:
+        case OP_NEGATE_N:
+        case OP_SUM:
+        case OP_MIN:
+        case OP_MAX:
+        case OP_RANGE:
+        case OP_LENGTH:
+        case OP_SET_LOCAL:
+            return 0;
+        // Binary operators, including their quickened forms
+        default:
+            return -1;
+    }
+}
@@ -17,9 +17,51 @@ typedef enum {
     OP_DIVIDE,
     OP_NOT,
     OP_NEGATE,
+    // Array builtins, each a single pass of a SIMD kernel
+    OP_SUM,
+    OP_DOT,
+    OP_MIN,
+    OP_MAX,
+    OP_RANGE,
+    // len() and a[i], over code points for strings
+    OP_LENGTH,
+    OP_INDEX,
+    // Stack slots relative to the stack base, reserved by the
+    // compiler to keep shared subexpression results
+    OP_GET_LOCAL,
+    OP_SET_LOCAL,
+    // Input column by index; only batch evaluation binds columns
+    OP_COLUMN,
     OP_RETURN,
+    // Unchecked forms the compiler emits when it has proven the
+    // operand types: numbers (N) or strings (OP_CONCAT)
+    OP_ADD_NN,
+    OP_SUBTRACT_NN,
+    OP_MULTIPLY_NN,
+    OP_DIVIDE_NN,
+    OP_LESS_NN,
+    OP_GREATER_NN,
+    OP_NEGATE_N,
+    OP_CONCAT,
+    // Type-specialized forms the VM rewrites generic opcodes into
+    // after observing operand types; never emitted by the compiler
+    OP_ADD_INT,
+    OP_ADD_NUM,
+    OP_ADD_STR,
+    OP_SUBTRACT_INT,
+    OP_SUBTRACT_NUM,
+    OP_MULTIPLY_INT,
+    OP_MULTIPLY_NUM,
+    OP_DIVIDE_NUM,
+    OP_LESS_INT,
+    OP_LESS_NUM,
+    OP_GREATER_INT,
+    OP_GREATER_NUM,
 } OpCode;
 
+// Opcodes are numbered densely from zero up to the last one above
+#define OP_COUNT (OP_GREATER_NUM + 1)
+
 typedef struct {
     // Number of element in use in array we have allocated
     int count;
@@ -28,6 +70,8 @@ typedef struct {
     uint8_t* code; // Hence, a bytecode
     int* lines;
     ValueArray constants; // Constant pool
+    bool frozen; // Shared read-only, see Chunk/frozen.h
+    int stackDepth; // Slots the chunk needs, 0 until verifyChunk()
 } Chunk;
 
 void initChunk(Chunk *chunk);
@@ -35,3 +79,7 @@ void freeChunk(Chunk *chunk);
 // Writes opcodes or operands
 void writeChunk(Chunk *chunk, uint8_t byte, int line);
 int addConstant(Chunk *chunk, Value value);
+// Bytes taken by the instruction at offset, operands included
+int instructionSize(Chunk *chunk, int offset);
+// Net stack slots pushed by the instruction at offset
+int stackEffect(Chunk *chunk, int offset);
@@ -0,0 +1,63 @@
+#include "frozen.h"
+#include "Core/heap.h"
+#include "Core/memory.h"
+#include "Core/object.h"
+#include "Frontend/compiler.h"
+
+#include <pthread.h>
+
+typedef struct FrozenChunk {
+    Chunk chunk;
+    struct FrozenChunk *next;
+} FrozenChunk;
+
+// Constants of frozen chunks live here rather than in any VM's heap, so
+// freeObjects() never sees them. The lock guards all three.
+static pthread_mutex_t frozenLock = PTHREAD_MUTEX_INITIALIZER;
+static ObjectHeap frozenHeap;
+static MemoryStats frozenStats;
+static FrozenChunk *frozenChunks = NULL;
+
+Chunk *compileFrozen(const char *source) {
+    pthread_mutex_lock(&frozenLock);
+    ObjectHeap *previousHeap = setObjectHeap(&frozenHeap);
+    MemoryStats *previousStats = setMemoryStats(&frozenStats);
+
+    FrozenChunk *frozen = ALLOCATE(FrozenChunk, 1, MEM_CHUNK);
+    initChunk(&frozen->chunk);
+
+    Chunk *chunk = NULL;
+    if (compile(source, &frozen->chunk)) {
+        frozen->chunk.frozen = true;
+        frozen->next = frozenChunks;
+        frozenChunks = frozen;
+        chunk = &frozen->chunk;
+    }
+    else {
+        freeChunk(&frozen->chunk);
+        FREE(FrozenChunk, frozen, MEM_CHUNK);
+    }
+
+    setMemoryStats(previousStats);
+    setObjectHeap(previousHeap);
+    pthread_mutex_unlock(&frozenLock);
+
+    return chunk;
+}
+
+void freeFrozenChunks() {
+    pthread_mutex_lock(&frozenLock);
+    MemoryStats *previousStats = setMemoryStats(&frozenStats);
+
+    while (frozenChunks != NULL) {
+        FrozenChunk *next = frozenChunks->next;
+        frozenChunks->chunk.frozen = false;
+        freeChunk(&frozenChunks->chunk);
+        FREE(FrozenChunk, frozenChunks, MEM_CHUNK);
+        frozenChunks = next;
+    }
+    freeHeap(&frozenHeap);
+
+    setMemoryStats(previousStats);
+    pthread_mutex_unlock(&frozenLock);
+}
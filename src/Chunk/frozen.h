@@ -0,0 +1,14 @@
+#pragma once
+
+#include "chunk.h"
+#include "common.h"
+
+// Chunks compiled once into a process-wide heap and never written to
+// again, so any number of fibers, or threads, can run them without a
+// copy. The VM does not quicken frozen chunks, and freeChunk() leaves
+// them alone; only freeFrozenChunks() releases them.
+
+// Returns NULL on a compile error. Safe to call from several threads.
+Chunk *compileFrozen(const char *source);
+// Frees every frozen chunk and its constants; none may still be running
+void freeFrozenChunks();
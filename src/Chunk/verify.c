@@ -0,0 +1,86 @@
+#include "verify.h"
+#include "Core/memory.h"
+#include "Core/object.h"
+
+const char *verifyChunk(Chunk *chunk) {
+    uint8_t *code = chunk->code;
+    // Which slots hold a proven string; straight-line code pushes at
+    // most one slot per instruction
+    bool *strings = ALLOCATE(bool, chunk->count + 1, MEM_COMPILER);
+    int depth = 0;
+    int maxDepth = 0;
+    uint8_t op = OP_COUNT;
+    const char *error = NULL;
+
+    for (int offset = 0; error == NULL && offset < chunk->count;
+         offset += instructionSize(chunk, offset))
+    {
+        op = code[offset];
+        if (op >= OP_COUNT) {
+            error = "Unknown opcode.";
+            break;
+        }
+        if (offset + instructionSize(chunk, offset) > chunk->count) {
+            error = "Instruction runs past the end of the chunk.";
+            break;
+        }
+
+        int effect = stackEffect(chunk, offset);
+        int operands = effect == 1 ? 0
+                     : effect == 0 || op == OP_RETURN ? 1 : 2;
+        if (depth < operands) {
+            error = "Stack underflow.";
+            break;
+        }
+
+        // Mirrors where inferTypes() proves a string
+        bool string = false;
+        switch (op) {
+            case OP_CONSTANT:
+                if (code[offset + 1] >= chunk->constants.count) {
+                    error = "Constant index out of range.";
+                    break;
+                }
+                string = IS_STRING(chunk->constants.values[code[offset + 1]]);
+                break;
+            case OP_GET_LOCAL:
+                if (code[offset + 1] >= depth) {
+                    error = "Local slot out of range.";
+                    break;
+                }
+                string = strings[code[offset + 1]];
+                break;
+            case OP_SET_LOCAL:
+                if (code[offset + 1] >= depth) {
+                    error = "Local slot out of range.";
+                    break;
+                }
+                string = strings[depth - 1];
+                strings[code[offset + 1]] = string;
+                break;
+            case OP_ADD:
+            case OP_ADD_STR:
+                string = strings[depth - 2] && strings[depth - 1];
+                break;
+            case OP_CONCAT:
+                if (!strings[depth - 2] || !strings[depth - 1])
+                    error = "Concatenated operands are not proven strings.";
+                string = true;
+                break;
+            case OP_INDEX:
+                string = strings[depth - 2];
+                break;
+        }
+
+        depth += effect;
+        if (op != OP_RETURN) strings[depth - 1] = string;
+        if (depth > maxDepth) maxDepth = depth;
+    }
+
+    if (error == NULL && op != OP_RETURN)
+        error = "Chunk does not end in OP_RETURN.";
+    if (error == NULL) chunk->stackDepth = maxDepth;
+
+    FREE_ARRAY(bool, strings, chunk->count + 1, MEM_COMPILER);
+    return error;
+}
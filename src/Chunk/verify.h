@@ -0,0 +1,11 @@
+#pragma once
+
+#include "chunk.h"
+#include "common.h"
+
+// Checks a chunk once so run() can trust it: every opcode is known and
+// complete, constant and local indices are in range, no instruction
+// pops more than is on the stack, OP_CONCAT only sees proven strings,
+// and the chunk ends in OP_RETURN. On success sets chunk->stackDepth
+// to the deepest the stack gets and returns NULL, else the problem.
+const char *verifyChunk(Chunk *chunk);
@@ -0,0 +1,365 @@
+#include "array.h"
+#include "cpu.h"
+#include "memory.h"
+#include "object.h"
+
+#include <stdint.h>
+
+// One ISA's kernels. Element-wise kernels take a null b to broadcast
+// the scalar instead; reductions see at least one element.
+typedef struct {
+    void (*add)(double *out, const double *a, const double *b, double scalar,
+                int count);
+    void (*multiply)(double *out, const double *a, const double *b,
+                     double scalar, int count);
+    double (*sum)(const double *a, int count);
+    double (*dot)(const double *a, const double *b, int count);
+    double (*min)(const double *a, int count);
+    double (*max)(const double *a, int count);
+} Kernels;
+
+static void addScalar(double *out, const double *a, const double *b,
+                      double scalar, int count)
+{
+    for (int i = 0; i < count; i++)
+        out[i] = a[i] + (b != NULL ? b[i] : scalar);
+}
+
+static void multiplyScalar(double *out, const double *a, const double *b,
+                           double scalar, int count)
+{
+    for (int i = 0; i < count; i++)
+        out[i] = a[i] * (b != NULL ? b[i] : scalar);
+}
+
+static double sumScalar(const double *a, int count) {
+    double sum = 0;
+    for (int i = 0; i < count; i++) sum += a[i];
+
+    return sum;
+}
+
+static double dotScalar(const double *a, const double *b, int count) {
+    double sum = 0;
+    for (int i = 0; i < count; i++) sum += a[i] * b[i];
+
+    return sum;
+}
+
+static double minScalar(const double *a, int count) {
+    double min = a[0];
+    for (int i = 1; i < count; i++) min = a[i] < min ? a[i] : min;
+
+    return min;
+}
+
+static double maxScalar(const double *a, int count) {
+    double max = a[0];
+    for (int i = 1; i < count; i++) max = a[i] > max ? a[i] : max;
+
+    return max;
+}
+
+#ifndef HAS_SIMD
+
+static const Kernels scalarKernels = {
+    addScalar, multiplyScalar, sumScalar, dotScalar, minScalar, maxScalar
+};
+
+#else
+
+// The SIMD kernels finish their tails with the scalar ones
+
+static void addSse2(double *out, const double *a, const double *b,
+                    double scalar, int count)
+{
+    __m128d broadcast = _mm_set1_pd(scalar);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d right = b != NULL ? _mm_loadu_pd(b + i) : broadcast;
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i), right));
+    }
+    addScalar(out + i, a + i, b != NULL ? b + i : NULL, scalar, count - i);
+}
+
+static void multiplySse2(double *out, const double *a, const double *b,
+                         double scalar, int count)
+{
+    __m128d broadcast = _mm_set1_pd(scalar);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d right = b != NULL ? _mm_loadu_pd(b + i) : broadcast;
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), right));
+    }
+    multiplyScalar(out + i, a + i, b != NULL ? b + i : NULL, scalar,
+                   count - i);
+}
+
+static double horizontalSse2(__m128d lanes) {
+    double parts[2];
+    _mm_storeu_pd(parts, lanes);
+
+    return parts[0] + parts[1];
+}
+
+static double sumSse2(const double *a, int count) {
+    __m128d sum = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+        sum = _mm_add_pd(sum, _mm_loadu_pd(a + i));
+
+    return horizontalSse2(sum) + sumScalar(a + i, count - i);
+}
+
+static double dotSse2(const double *a, const double *b, int count) {
+    __m128d sum = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(a + i),
+                                         _mm_loadu_pd(b + i)));
+    }
+
+    return horizontalSse2(sum) + dotScalar(a + i, b + i, count - i);
+}
+
+static double minSse2(const double *a, int count) {
+    if (count < 2) return minScalar(a, count);
+
+    __m128d min = _mm_loadu_pd(a);
+    int i = 2;
+    for (; i + 2 <= count; i += 2)
+        min = _mm_min_pd(min, _mm_loadu_pd(a + i));
+
+    double parts[2];
+    _mm_storeu_pd(parts, min);
+    double result = parts[0] < parts[1] ? parts[0] : parts[1];
+    for (; i < count; i++) result = a[i] < result ? a[i] : result;
+
+    return result;
+}
+
+static double maxSse2(const double *a, int count) {
+    if (count < 2) return maxScalar(a, count);
+
+    __m128d max = _mm_loadu_pd(a);
+    int i = 2;
+    for (; i + 2 <= count; i += 2)
+        max = _mm_max_pd(max, _mm_loadu_pd(a + i));
+
+    double parts[2];
+    _mm_storeu_pd(parts, max);
+    double result = parts[0] > parts[1] ? parts[0] : parts[1];
+    for (; i < count; i++) result = a[i] > result ? a[i] : result;
+
+    return result;
+}
+
+static const Kernels sse2Kernels = {
+    addSse2, multiplySse2, sumSse2, dotSse2, minSse2, maxSse2
+};
+
+AVX2 static void addAvx2(double *out, const double *a, const double *b,
+                         double scalar, int count)
+{
+    __m256d broadcast = _mm256_set1_pd(scalar);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d right = b != NULL ? _mm256_loadu_pd(b + i) : broadcast;
+        _mm256_storeu_pd(out + i,
+                         _mm256_add_pd(_mm256_loadu_pd(a + i), right));
+    }
+    addScalar(out + i, a + i, b != NULL ? b + i : NULL, scalar, count - i);
+}
+
+AVX2 static void multiplyAvx2(double *out, const double *a, const double *b,
+                              double scalar, int count)
+{
+    __m256d broadcast = _mm256_set1_pd(scalar);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d right = b != NULL ? _mm256_loadu_pd(b + i) : broadcast;
+        _mm256_storeu_pd(out + i,
+                         _mm256_mul_pd(_mm256_loadu_pd(a + i), right));
+    }
+    multiplyScalar(out + i, a + i, b != NULL ? b + i : NULL, scalar,
+                   count - i);
+}
+
+AVX2 static double horizontalAvx2(__m256d lanes) {
+    double parts[4];
+    _mm256_storeu_pd(parts, lanes);
+
+    return (parts[0] + parts[1]) + (parts[2] + parts[3]);
+}
+
+AVX2 static double sumAvx2(const double *a, int count) {
+    __m256d sum = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(a + i));
+
+    return horizontalAvx2(sum) + sumScalar(a + i, count - i);
+}
+
+AVX2 static double dotAvx2(const double *a, const double *b, int count) {
+    __m256d sum = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+                                               _mm256_loadu_pd(b + i)));
+    }
+
+    return horizontalAvx2(sum) + dotScalar(a + i, b + i, count - i);
+}
+
+AVX2 static double minAvx2(const double *a, int count) {
+    if (count < 4) return minScalar(a, count);
+
+    __m256d min = _mm256_loadu_pd(a);
+    int i = 4;
+    for (; i + 4 <= count; i += 4)
+        min = _mm256_min_pd(min, _mm256_loadu_pd(a + i));
+
+    double parts[4];
+    _mm256_storeu_pd(parts, min);
+    double result = minScalar(parts, 4);
+    for (; i < count; i++) result = a[i] < result ? a[i] : result;
+
+    return result;
+}
+
+AVX2 static double maxAvx2(const double *a, int count) {
+    if (count < 4) return maxScalar(a, count);
+
+    __m256d max = _mm256_loadu_pd(a);
+    int i = 4;
+    for (; i + 4 <= count; i += 4)
+        max = _mm256_max_pd(max, _mm256_loadu_pd(a + i));
+
+    double parts[4];
+    _mm256_storeu_pd(parts, max);
+    double result = maxScalar(parts, 4);
+    for (; i < count; i++) result = a[i] > result ? a[i] : result;
+
+    return result;
+}
+
+static const Kernels avx2Kernels = {
+    addAvx2, multiplyAvx2, sumAvx2, dotAvx2, minAvx2, maxAvx2
+};
+
+#endif
+
+static const Kernels *kernels() {
+#ifdef HAS_SIMD
+    return cpuHasAvx2() ? &avx2Kernels : &sse2Kernels;
+#else
+    return &scalarKernels;
+#endif
+}
+
+bool isArrayArithmetic(Value a, Value b) {
+    return (IS_ARRAY(a) && (IS_ARRAY(b) || IS_NUMBER(b))) ||
+           (IS_ARRAY(b) && IS_NUMBER(a));
+}
+
+// Arrays are as long as the program asks, so their elements are checked
+// against the heap limit before they are allocated
+static bool reserveArray(int64_t count) {
+    return reserveHeap(sizeof(double) * (size_t)count);
+}
+
+static const char *elementwise(Value a, Value b, bool multiply,
+                               Value *result)
+{
+    // Both operators commute, so keep the array on the left
+    if (!IS_ARRAY(a)) {
+        Value swap = a;
+        a = b;
+        b = swap;
+    }
+
+    ObjArray *left = AS_ARRAY(a);
+    const double *right = NULL;
+    double scalar = 0;
+    if (IS_ARRAY(b)) {
+        if (AS_ARRAY(b)->count != left->count)
+            return "Array lengths must match.";
+        right = AS_ARRAY(b)->values;
+    }
+    else {
+        scalar = AS_NUMBER(b);
+    }
+
+    if (!reserveArray(left->count)) return "Heap limit exceeded.";
+    ObjArray *array = newArray(left->count);
+    if (multiply) {
+        kernels()->multiply(array->values, left->values, right, scalar,
+                            left->count);
+    }
+    else {
+        kernels()->add(array->values, left->values, right, scalar,
+                       left->count);
+    }
+
+    *result = MAKE_OBJ_VAL(array);
+    return NULL;
+}
+
+const char *arrayAdd(Value a, Value b, Value *result) {
+    return elementwise(a, b, false, result);
+}
+
+const char *arrayMultiply(Value a, Value b, Value *result) {
+    return elementwise(a, b, true, result);
+}
+
+const char *arraySum(Value array, Value *result) {
+    if (!IS_ARRAY(array)) return "Operand must be an array.";
+
+    ObjArray *values = AS_ARRAY(array);
+    *result = MAKE_NUMBER_VAL(values->count == 0
+        ? 0 : kernels()->sum(values->values, values->count));
+    return NULL;
+}
+
+const char *arrayDot(Value a, Value b, Value *result) {
+    if (!IS_ARRAY(a) || !IS_ARRAY(b)) return "Operands must be arrays.";
+    if (AS_ARRAY(a)->count != AS_ARRAY(b)->count)
+        return "Array lengths must match.";
+
+    int count = AS_ARRAY(a)->count;
+    *result = MAKE_NUMBER_VAL(count == 0 ? 0
+        : kernels()->dot(AS_ARRAY(a)->values, AS_ARRAY(b)->values, count));
+    return NULL;
+}
+
+const char *arrayMin(Value array, Value *result) {
+    if (!IS_ARRAY(array)) return "Operand must be an array.";
+    if (AS_ARRAY(array)->count == 0) return "Array must not be empty.";
+
+    ObjArray *values = AS_ARRAY(array);
+    *result = MAKE_NUMBER_VAL(kernels()->min(values->values, values->count));
+    return NULL;
+}
+
+const char *arrayMax(Value array, Value *result) {
+    if (!IS_ARRAY(array)) return "Operand must be an array.";
+    if (AS_ARRAY(array)->count == 0) return "Array must not be empty.";
+
+    ObjArray *values = AS_ARRAY(array);
+    *result = MAKE_NUMBER_VAL(kernels()->max(values->values, values->count));
+    return NULL;
+}
+
+const char *arrayRange(Value length, Value *result) {
+    if (!IS_INT(length) || AS_INT(length) < 0 || AS_INT(length) > INT32_MAX)
+        return "Range length must be a non-negative integer.";
+
+    if (!reserveArray(AS_INT(length))) return "Heap limit exceeded.";
+    ObjArray *array = newArray((int)AS_INT(length));
+    for (int i = 0; i < array->count; i++) array->values[i] = i;
+
+    *result = MAKE_OBJ_VAL(array);
+    return NULL;
+}
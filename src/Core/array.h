@@ -0,0 +1,19 @@
+#pragma once
+
+#include "common.h"
+#include "value.h"
+
+// Array operations shared by the VM and generated C. Each returns NULL
+// on success or the runtime error message, leaving result untouched.
+
+// True when a + b or a * b is element-wise: one side is an array and
+// the other an array or a number
+bool isArrayArithmetic(Value a, Value b);
+const char *arrayAdd(Value a, Value b, Value *result);
+const char *arrayMultiply(Value a, Value b, Value *result);
+const char *arraySum(Value array, Value *result);
+const char *arrayDot(Value a, Value b, Value *result);
+const char *arrayMin(Value array, Value *result);
+const char *arrayMax(Value array, Value *result);
+// [0, 1, ..., length - 1]
+const char *arrayRange(Value length, Value *result);
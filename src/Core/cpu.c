@@ -0,0 +1,21 @@
+#include "cpu.h"
+
+#include <stdatomic.h>
+
+bool cpuHasAvx2() {
+#ifdef HAS_SIMD
+    // -1 until probed; threads racing on the first call store the same
+    // answer
+    static _Atomic int hasAvx2 = -1;
+
+    int cached = atomic_load_explicit(&hasAvx2, memory_order_relaxed);
+    if (cached < 0) {
+        cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+        atomic_store_explicit(&hasAvx2, cached, memory_order_relaxed);
+    }
+
+    return cached == 1;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "common.h"
+
+// SIMD kernels target x86-64, whose baseline already includes SSE2.
+// AVX2 versions are compiled for that target function by function and
+// may only run where cpuHasAvx2() says so.
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAS_SIMD
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+// Probed on first use, then cached; safe to call from any thread
+bool cpuHasAvx2();
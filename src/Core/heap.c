@@ -0,0 +1,95 @@
+#include "heap.h"
+#include "memory.h"
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BITMAP_WORDS (HEAP_PAGE_SIZE / HEAP_SLOT_ALIGN / 64)
+
+struct HeapPage {
+    HeapPage *next; // Next page of the same size class
+    int slotSize;
+    int slotCount;
+    int used;
+    uint64_t occupied[BITMAP_WORDS]; // Bit per slot, set when live
+    alignas(HEAP_SLOT_ALIGN) unsigned char slots[];
+};
+
+void initHeap(ObjectHeap *heap) {
+    for (int i = 0; i < HEAP_SIZE_CLASSES; i++)
+        heap->pages[i] = NULL;
+}
+
+static HeapPage *newPage(int slotSize) {
+    HeapPage *page = (HeapPage*)ALLOCATE(unsigned char, HEAP_PAGE_SIZE,
+                                         MEM_OBJECTS);
+    page->next = NULL;
+    page->slotSize = slotSize;
+    page->slotCount =
+        (HEAP_PAGE_SIZE - (int)offsetof(HeapPage, slots)) / slotSize;
+    page->used = 0;
+    for (int i = 0; i < BITMAP_WORDS; i++)
+        page->occupied[i] = 0;
+
+    return page;
+}
+
+// Claims the lowest free slot, so a page fills front to back
+static void *claimSlot(HeapPage *page) {
+    for (int word = 0; word < BITMAP_WORDS; word++) {
+        uint64_t free = ~page->occupied[word];
+        if (free == 0) continue;
+
+        int slot = word * 64 + __builtin_ctzll(free);
+        if (slot >= page->slotCount) break;
+
+        page->occupied[word] |= 1ULL << (slot % 64);
+        page->used++;
+        return page->slots + (size_t)slot * page->slotSize;
+    }
+
+    return NULL;
+}
+
+Obj *heapAllocate(ObjectHeap *heap, size_t size) {
+    size_t sizeClass = (size + HEAP_SLOT_ALIGN - 1) / HEAP_SLOT_ALIGN - 1;
+    if (sizeClass >= HEAP_SIZE_CLASSES) {
+        fprintf(stderr, "Object of %zu bytes exceeds the largest slot.\n",
+                size);
+        exit(1);
+    }
+
+    HeapPage *page = heap->pages[sizeClass];
+    if (page == NULL || page->used == page->slotCount) {
+        page = newPage((int)(sizeClass + 1) * HEAP_SLOT_ALIGN);
+        page->next = heap->pages[sizeClass];
+        heap->pages[sizeClass] = page;
+    }
+
+    return (Obj*)claimSlot(page);
+}
+
+void freeHeap(ObjectHeap *heap) {
+    for (int sizeClass = 0; sizeClass < HEAP_SIZE_CLASSES; sizeClass++) {
+        HeapPage *page = heap->pages[sizeClass];
+        while (page != NULL) {
+            // Walk the bitmap rather than the slots to skip holes
+            for (int word = 0; word < BITMAP_WORDS; word++) {
+                uint64_t live = page->occupied[word];
+                while (live != 0) {
+                    int slot = word * 64 + __builtin_ctzll(live);
+                    live &= live - 1;
+                    freeObject((Obj*)(page->slots +
+                                      (size_t)slot * page->slotSize));
+                }
+            }
+
+            HeapPage *next = page->next;
+            FREE_ARRAY(unsigned char, page, HEAP_PAGE_SIZE, MEM_OBJECTS);
+            page = next;
+        }
+        heap->pages[sizeClass] = NULL;
+    }
+}
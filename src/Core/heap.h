@@ -0,0 +1,22 @@
+#pragma once
+
+#include "common.h"
+#include "object.h"
+
+#define HEAP_PAGE_SIZE 4096
+#define HEAP_SLOT_ALIGN 16
+// Size classes step by HEAP_SLOT_ALIGN, so the largest slot is 128 bytes
+#define HEAP_SIZE_CLASSES 8
+
+typedef struct HeapPage HeapPage;
+
+// Objects live in fixed-size pages, one page list per size class. A
+// zeroed ObjectHeap is empty and ready to use.
+struct ObjectHeap {
+    HeapPage *pages[HEAP_SIZE_CLASSES]; // Most recently added first
+};
+
+void initHeap(ObjectHeap *heap);
+Obj *heapAllocate(ObjectHeap *heap, size_t size);
+// Frees every live object page by page, then the pages themselves
+void freeHeap(ObjectHeap *heap);
@@ -1,42 +1,153 @@
 #include "memory.h"
+#include "metrics.h"
 #include "VM/vm.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 
-void* reallocate(void* pointer, size_t oldSize, size_t newSize) {
+// Compile workers account into their own stats
+static _Thread_local MemoryStats *stats = &vm.memory;
+
+MemoryStats *setMemoryStats(MemoryStats *newStats) {
+    MemoryStats *previous = stats;
+    stats = newStats;
+
+    return previous;
+}
+
+MemoryStats *memoryStats() {
+    return stats;
+}
+
+void* reallocate(void* pointer, size_t oldSize, size_t newSize,
+                 MemoryTag tag)
+{
+    void *result = NULL;
     if (newSize == 0) {
         free(pointer);
-        return NULL;
+    }
+    else {
+        result = realloc(pointer, newSize);
+        if (result == NULL) {
+            fprintf(stderr, "Out of memory allocating %zu bytes.\n", newSize);
+            exit(1); // return due to memory allocation error
+        }
     }
 
-    void *result = realloc(pointer, newSize);
+    // Counted only once the memory is really there
+    stats->bytesAllocated += newSize - oldSize;
+    stats->tagBytes[tag] += newSize - oldSize;
 
-    if (result == NULL)
-        exit(1); // return due to memory allocation error
+    if (newSize > oldSize) {
+        COUNT_METRIC(bytesAllocated, newSize - oldSize);
+        if (oldSize == 0) COUNT_METRIC(allocations, 1);
+
+        if (stats->bytesAllocated > stats->peakBytes)
+            stats->peakBytes = stats->bytesAllocated;
+
+        // Small allocations go through; the VM turns the latched flag
+        // into a runtime error at its next safe point
+        if (stats->maxBytes != 0 && stats->bytesAllocated > stats->maxBytes)
+            stats->limitExceeded = true;
+    }
+    else {
+        COUNT_METRIC(bytesFreed, oldSize - newSize);
+    }
 
     return result;
 }
 
-static void freeObject(Obj *object) {
+bool reserveHeap(size_t bytes) {
+    if (stats->maxBytes == 0) return true;
+
+    if (bytes > stats->maxBytes ||
+        stats->bytesAllocated > stats->maxBytes - bytes)
+    {
+        stats->limitExceeded = true;
+        return false;
+    }
+
+    return true;
+}
+
+void trackObject(ObjType type, size_t size, bool allocated) {
+    if (allocated) {
+        stats->objectBytes[type] += size;
+        stats->objectCounts[type]++;
+        COUNT_METRIC(objectsAllocated, 1);
+    }
+    else {
+        stats->objectBytes[type] -= size;
+        stats->objectCounts[type]--;
+        COUNT_METRIC(objectsFreed, 1);
+    }
+}
+
+void clearHeapLimit() {
+    stats->limitExceeded = false;
+}
+
+void printMemoryStats(FILE *out) {
+    static const char *tagNames[] = {
+        [MEM_CHUNK] = "chunk",
+        [MEM_CONSTANTS] = "constants",
+        [MEM_STRINGS] = "strings",
+        [MEM_ARRAYS] = "arrays",
+        [MEM_OBJECTS] = "objects",
+        [MEM_COMPILER] = "compiler",
+        [MEM_OUTPUT] = "output",
+        [MEM_FIBERS] = "fibers",
+        [MEM_TRACE] = "trace",
+        [MEM_BATCH] = "batch",
+        [MEM_STACKS] = "stacks",
+    };
+    static const char *typeNames[] = {
+        [OBJ_STRING] = "string",
+        [OBJ_ARRAY] = "array",
+    };
+
+    fprintf(out, "heap: %zu bytes live, %zu peak",
+            stats->bytesAllocated, stats->peakBytes);
+    if (stats->maxBytes != 0)
+        fprintf(out, ", %zu limit", stats->maxBytes);
+    fprintf(out, "\n");
+
+    for (int tag = 0; tag < MEM_TAG_COUNT; tag++)
+        fprintf(out, "  %-10s %10zu bytes\n", tagNames[tag],
+                stats->tagBytes[tag]);
+    for (int type = 0; type < OBJ_TYPE_COUNT; type++)
+        fprintf(out, "  %-10s %10zu bytes in %zu objects\n",
+                typeNames[type], stats->objectBytes[type],
+                stats->objectCounts[type]);
+}
+
+void freeObject(Obj *object) {
     switch (object->type) {
         case OBJ_STRING: {
-            // ObjString owns heap char buffer, so we free it first
+            // ObjString owns heap char buffer, so we free it first,
+            // unless it only views script text
             ObjString *string = (ObjString*)object;
-            FREE_ARRAY(char, string->chars, string->length + 1);
+            if (string->source != NULL) {
+                releaseSource(string->source);
+            }
+            else {
+                FREE_ARRAY(char, string->chars, string->length + 1,
+                           MEM_STRINGS);
+            }
+
+            trackObject(OBJ_STRING, sizeof(ObjString), false);
+            break;
+        }
+        case OBJ_ARRAY: {
+            ObjArray *array = (ObjArray*)object;
+            FREE_ARRAY(double, array->values, array->count, MEM_ARRAYS);
 
-            FREE(ObjString, object);
+            trackObject(OBJ_ARRAY, sizeof(ObjArray), false);
             break;
         }
     }
 }
 
 void freeObjects() {
-    Obj *object = vm.objects;
-
-    // Iterate through Obj linked list
-    while (object != NULL) {
-        Obj *next = object->next;
-        freeObject(object);
-        object = next;
-    }
+    freeHeap(&vm.heap);
 }
@@ -3,21 +3,60 @@
 #include "common.h"
 #include "object.h"
 
-#define ALLOCATE(type, count) \
-    (type*)reallocate(NULL, 0, sizeof(type) * (count))
+#define ALLOCATE(type, count, tag) \
+    (type*)reallocate(NULL, 0, sizeof(type) * (count), tag)
 
 #define GROW_CAPACITY(capacity) \
     ((capacity) < 8 ? 8 : (capacity) * 2)
 
-#define GROW_ARRAY(type, pointer, oldCapacity, newCapacity) \
+#define GROW_ARRAY(type, pointer, oldCapacity, newCapacity, tag) \
 (type*)reallocate(pointer, sizeof(type) * (oldCapacity), \
-                  sizeof(type) * (newCapacity))
-
-#define FREE_ARRAY(type, pointer, currCapacity) \
-(type*)reallocate(pointer, sizeof(type) * (currCapacity), 0)
-
-#define FREE(type, pointer) reallocate(pointer, sizeof(type), 0)
-
-void* reallocate(void* pointer, size_t oldSize, size_t newSize);
-
+                  sizeof(type) * (newCapacity), tag)
+
+#define FREE_ARRAY(type, pointer, currCapacity, tag) \
+(type*)reallocate(pointer, sizeof(type) * (currCapacity), 0, tag)
+
+#define FREE(type, pointer, tag) reallocate(pointer, sizeof(type), 0, tag)
+
+// Subsystem every allocation is accounted to
+typedef enum {
+    MEM_CHUNK, // Bytecode and line tables
+    MEM_CONSTANTS, // Value arrays
+    MEM_STRINGS, // String character buffers
+    MEM_ARRAYS, // Array elements
+    MEM_OBJECTS, // Object heap pages
+    MEM_COMPILER, // Transient compiler and tooling buffers
+    MEM_OUTPUT, // Output buffers
+    MEM_FIBERS, // Fibers, their chunks aside
+    MEM_TRACE, // Execution trace rings
+    MEM_BATCH, // Batch columns, lanes and results
+    MEM_STACKS, // VM stacks for chunks deeper than STACK_MAX
+    MEM_TAG_COUNT
+} MemoryTag;
+
+typedef struct {
+    size_t bytesAllocated; // Live bytes
+    size_t peakBytes; // High watermark of bytesAllocated
+    size_t maxBytes; // Hard limit, 0 when unlimited
+    bool limitExceeded; // Latched until clearHeapLimit()
+    size_t tagBytes[MEM_TAG_COUNT];
+    size_t objectBytes[OBJ_TYPE_COUNT];
+    size_t objectCounts[OBJ_TYPE_COUNT];
+} MemoryStats;
+
+void* reallocate(void* pointer, size_t oldSize, size_t newSize,
+                 MemoryTag tag);
+// Redirects this thread's accounting, returns the old stats
+MemoryStats *setMemoryStats(MemoryStats *stats);
+MemoryStats *memoryStats();
+// Whether bytes more fit under this thread's heap limit. Allocations
+// whose size the program controls check first, so going over the
+// limit fails them instead of allocating; the flag latches either way.
+bool reserveHeap(size_t bytes);
+void trackObject(ObjType type, size_t size, bool allocated);
+void clearHeapLimit();
+void printMemoryStats(FILE *out);
+
+// Releases what object owns; its slot belongs to the heap
+void freeObject(Obj *object);
 void freeObjects();
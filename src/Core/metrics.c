@@ -0,0 +1,42 @@
+#include "metrics.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+Metrics *metrics = NULL;
+
+bool openMetrics(const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    // A fresh file reads as zeros, so every counter starts at 0
+    if (ftruncate(fd, sizeof(Metrics)) != 0) {
+        close(fd);
+        return false;
+    }
+
+    void *page = mmap(NULL, sizeof(Metrics), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) return false;
+
+    Metrics *opened = page;
+    opened->version = METRICS_VERSION;
+    opened->size = sizeof(Metrics);
+    opened->pid = getpid();
+    // Last, so readers never accept a half-written header
+    atomic_thread_fence(memory_order_release);
+    memcpy(opened->magic, METRICS_MAGIC, sizeof(opened->magic));
+
+    metrics = opened;
+    return true;
+}
+
+void closeMetrics() {
+    if (metrics == NULL) return;
+
+    munmap(metrics, sizeof(Metrics));
+    metrics = NULL;
+}
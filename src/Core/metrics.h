@@ -0,0 +1,44 @@
+#pragma once
+
+#include "common.h"
+
+#include <stdatomic.h>
+
+#define METRICS_MAGIC "CLOXMTRC"
+#define METRICS_VERSION 1
+
+// Counters page mapped from a file, so tools can poll a running
+// interpreter without stopping it. Every counter only grows; writers
+// add with relaxed atomics, so a reader sees each counter whole but not
+// a consistent cut across them.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t size; // sizeof(Metrics) of the writer
+    int64_t pid;
+    _Atomic uint64_t allocations; // Blocks reallocate() created
+    _Atomic uint64_t bytesAllocated;
+    _Atomic uint64_t bytesFreed;
+    _Atomic uint64_t objectsAllocated;
+    _Atomic uint64_t objectsFreed;
+    _Atomic uint64_t instructions; // Interpreted, not JIT-compiled
+    _Atomic uint64_t compiles;
+    _Atomic uint64_t compileErrors;
+    _Atomic uint64_t compileNanoseconds;
+    _Atomic uint64_t runtimeErrors;
+} Metrics;
+
+// NULL unless openMetrics() succeeded
+extern Metrics *metrics;
+
+#define COUNT_METRIC(counter, amount) \
+    do { \
+        if (metrics != NULL) \
+            atomic_fetch_add_explicit(&metrics->counter, (amount), \
+                                      memory_order_relaxed); \
+    } while (false)
+
+// Creates or truncates path and maps the counters from it; false when
+// that fails. The file is left behind with the final counts.
+bool openMetrics(const char *path);
+void closeMetrics();
@@ -0,0 +1,355 @@
+#include "number.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Formatting follows Grisu2 (Loitsch, "Printing Floating-Point Numbers
+// Quickly and Accurately"): the value and its rounding boundaries are
+// scaled by a cached power of ten into 64-bit fixed point, and digits
+// are generated until they fall strictly inside the boundaries. The
+// output always round-trips and is the shortest in all but rare cases.
+
+#define SIGNIFICAND_BITS 52
+#define HIDDEN_BIT (1ULL << SIGNIFICAND_BITS)
+#define SIGNIFICAND_MASK (HIDDEN_BIT - 1)
+#define EXPONENT_BIAS (1023 + SIGNIFICAND_BITS)
+
+// Unpacked floating point: f * 2^e
+typedef struct {
+    uint64_t f;
+    int e;
+} DiyFp;
+
+// Normalized 10^k for k = -348, -340, ..., 340
+static const uint64_t cachedPowerSignificands[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+static const int16_t cachedPowerExponents[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const uint64_t powersOf10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL,
+    10000000000000000000ULL
+};
+
+static DiyFp diyFromDouble(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    int biasedExponent = (int)((bits >> SIGNIFICAND_BITS) & 0x7ff);
+    uint64_t significand = bits & SIGNIFICAND_MASK;
+    if (biasedExponent != 0)
+        return (DiyFp){significand + HIDDEN_BIT,
+                       biasedExponent - EXPONENT_BIAS};
+
+    return (DiyFp){significand, 1 - EXPONENT_BIAS}; // Subnormal
+}
+
+static DiyFp normalize(DiyFp value) {
+    int shift = __builtin_clzll(value.f);
+
+    return (DiyFp){value.f << shift, value.e - shift};
+}
+
+// Product rounded to the upper 64 bits
+static DiyFp multiply(DiyFp a, DiyFp b) {
+    unsigned __int128 product = (unsigned __int128)a.f * b.f;
+    uint64_t high = (uint64_t)(product >> 64);
+    if ((uint64_t)product & (1ULL << 63)) high++;
+
+    return (DiyFp){high, a.e + b.e + 64};
+}
+
+// Midpoints to the neighbouring doubles, sharing the upper's exponent
+static void boundaries(DiyFp value, DiyFp *lower, DiyFp *upper) {
+    *upper = normalize((DiyFp){(value.f << 1) + 1, value.e - 1});
+
+    // The gap below a power of two is half the gap above it
+    if (value.f == HIDDEN_BIT)
+        *lower = (DiyFp){(value.f << 2) - 1, value.e - 2};
+    else
+        *lower = (DiyFp){(value.f << 1) - 1, value.e - 1};
+
+    lower->f <<= lower->e - upper->e;
+    lower->e = upper->e;
+}
+
+// Power c = 10^-k with the scaled exponent landing in [-60, -32]
+static DiyFp cachedPower(int e, int *k) {
+    double estimate = (-61 - e) * 0.30102999566398114 + 347;
+    int index = (int)estimate;
+    if (estimate - index > 0) index++;
+    index = (index >> 3) + 1;
+    *k = -(-348 + index * 8);
+
+    return (DiyFp){cachedPowerSignificands[index],
+                   cachedPowerExponents[index]};
+}
+
+static int countDigits(uint32_t n) {
+    int digits = 1;
+    while (digits < 10 && n >= powersOf10[digits]) digits++;
+
+    return digits;
+}
+
+// Nudges the last digit down while that moves closer to the value
+static void roundDigit(char *digits, int length, uint64_t delta,
+                       uint64_t rest, uint64_t tenKappa, uint64_t distance)
+{
+    while (rest < distance && delta - rest >= tenKappa &&
+           (rest + tenKappa < distance ||
+            distance - rest > rest + tenKappa - distance)) {
+        digits[length - 1]--;
+        rest += tenKappa;
+    }
+}
+
+static int generateDigits(DiyFp value, DiyFp upper, uint64_t delta,
+                          char *digits, int *k)
+{
+    DiyFp one = {1ULL << -upper.e, upper.e};
+    uint64_t distance = upper.f - value.f;
+    uint32_t integral = (uint32_t)(upper.f >> -one.e);
+    uint64_t fraction = upper.f & (one.f - 1);
+    int kappa = countDigits(integral);
+    int length = 0;
+
+    while (kappa > 0) {
+        uint32_t digit = integral / (uint32_t)powersOf10[kappa - 1];
+        integral %= (uint32_t)powersOf10[kappa - 1];
+        if (digit != 0 || length != 0) digits[length++] = '0' + digit;
+        kappa--;
+
+        uint64_t rest = ((uint64_t)integral << -one.e) + fraction;
+        if (rest <= delta) {
+            *k += kappa;
+            roundDigit(digits, length, delta, rest,
+                       powersOf10[kappa] << -one.e, distance);
+            return length;
+        }
+    }
+
+    for (;;) {
+        fraction *= 10;
+        delta *= 10;
+        char digit = (char)(fraction >> -one.e);
+        if (digit != 0 || length != 0) digits[length++] = '0' + digit;
+        fraction &= one.f - 1;
+        kappa--;
+
+        if (fraction < delta) {
+            *k += kappa;
+            roundDigit(digits, length, delta, fraction, one.f,
+                       -kappa < 20 ? distance * powersOf10[-kappa] : 0);
+            return length;
+        }
+    }
+}
+
+// Lays out digits * 10^exponent the way %g does with precision
+// max(length, 6): fixed notation for decimal exponents in [-4, precision)
+static int layout(const char *digits, int length, int exponent,
+                  char *buffer)
+{
+    int precision = length > 6 ? length : 6;
+    int point = exponent + length - 1; // Exponent in scientific notation
+    int out = 0;
+
+    if (point >= -4 && point < precision) {
+        if (point < 0) {
+            buffer[out++] = '0';
+            buffer[out++] = '.';
+            for (int i = -1; i > point; i--) buffer[out++] = '0';
+            memcpy(buffer + out, digits, length);
+            return out + length;
+        }
+
+        for (int i = 0; i <= point; i++)
+            buffer[out++] = i < length ? digits[i] : '0';
+        if (length > point + 1) {
+            buffer[out++] = '.';
+            memcpy(buffer + out, digits + point + 1, length - point - 1);
+            out += length - point - 1;
+        }
+        return out;
+    }
+
+    buffer[out++] = digits[0];
+    if (length > 1) {
+        buffer[out++] = '.';
+        memcpy(buffer + out, digits + 1, length - 1);
+        out += length - 1;
+    }
+    buffer[out++] = 'e';
+    buffer[out++] = point < 0 ? '-' : '+';
+    int magnitude = point < 0 ? -point : point;
+    if (magnitude >= 100) buffer[out++] = '0' + magnitude / 100;
+    buffer[out++] = '0' + magnitude / 10 % 10;
+    buffer[out++] = '0' + magnitude % 10;
+
+    return out;
+}
+
+int formatDouble(double value, char *buffer) {
+    if (!isfinite(value))
+        return snprintf(buffer, NUMBER_BUFFER_SIZE, "%g", value);
+
+    int out = 0;
+    if (signbit(value)) {
+        buffer[out++] = '-';
+        value = -value;
+    }
+    if (value == 0) {
+        buffer[out++] = '0';
+        return out;
+    }
+
+    DiyFp lower, upper;
+    DiyFp exact = diyFromDouble(value);
+    boundaries(exact, &lower, &upper);
+
+    int k;
+    DiyFp power = cachedPower(upper.e, &k);
+    DiyFp scaled = multiply(normalize(exact), power);
+    DiyFp scaledUpper = multiply(upper, power);
+    DiyFp scaledLower = multiply(lower, power);
+    // Stay strictly inside the boundaries despite rounding in multiply
+    scaledLower.f++;
+    scaledUpper.f--;
+
+    char digits[20];
+    int length = generateDigits(scaled, scaledUpper,
+                                scaledUpper.f - scaledLower.f, digits, &k);
+
+    return out + layout(digits, length, k, buffer + out);
+}
+
+int formatInteger(int64_t value, char *buffer) {
+    // Digits come out backwards; trailing zeros fold into the exponent
+    char reversed[20];
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    int exponent = 0;
+    int length = 0;
+
+    if (magnitude == 0) return layout("0", 1, 0, buffer);
+    while (magnitude % 10 == 0) {
+        magnitude /= 10;
+        exponent++;
+    }
+    while (magnitude != 0) {
+        reversed[length++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    }
+
+    char digits[20];
+    for (int i = 0; i < length; i++)
+        digits[i] = reversed[length - 1 - i];
+
+    int out = 0;
+    if (value < 0) buffer[out++] = '-';
+
+    return out + layout(digits, length, exponent, buffer + out);
+}
+
+bool parseInteger(const char *start, int length, int64_t *value) {
+    int64_t result = 0;
+
+    for (int i = 0; i < length; i++) {
+        if (start[i] == '.') return false;
+        if (__builtin_mul_overflow(result, 10, &result) ||
+            __builtin_add_overflow(result, start[i] - '0', &result))
+            return false;
+    }
+
+    *value = result;
+    return true;
+}
+
+// Exactly representable powers of ten
+static const double exactPowersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// strtod on a terminated copy, so it cannot read past the literal
+static double slowParse(const char *start, int length) {
+    char local[64];
+    char *copy = length < (int)sizeof(local) ? local : malloc(length + 1);
+    memcpy(copy, start, length);
+    copy[length] = '\0';
+
+    double value = strtod(copy, NULL);
+    if (copy != local) free(copy);
+
+    return value;
+}
+
+double parseDouble(const char *start, int length) {
+    // Clinger's fast path: when the digits fit a double's significand and
+    // the scale is an exact power of ten, one correctly rounded multiply
+    // or divide gives the correctly rounded result
+    uint64_t significand = 0;
+    int significantDigits = 0;
+    int fractionDigits = 0;
+    bool inFraction = false;
+
+    for (int i = 0; i < length; i++) {
+        if (start[i] == '.') {
+            inFraction = true;
+            continue;
+        }
+
+        significand = significand * 10 + (start[i] - '0');
+        if (significand != 0) significantDigits++;
+        if (inFraction) fractionDigits++;
+        if (significantDigits > 15) return slowParse(start, length);
+    }
+
+    if (fractionDigits > 22) return slowParse(start, length);
+
+    return (double)significand / exactPowersOf10[fractionDigits];
+}
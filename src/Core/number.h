@@ -0,0 +1,17 @@
+#pragma once
+
+#include "common.h"
+
+// Enough for a sign, 20 digits, a point and an exponent
+#define NUMBER_BUFFER_SIZE 32
+
+// Both write the shortest digits that read back to the same number,
+// laid out like printf("%g") with at least 6 digits of precision. They
+// return the length written, without a terminator.
+int formatDouble(double value, char *buffer);
+int formatInteger(int64_t value, char *buffer);
+
+// Parse a lexer-validated literal: digits with an optional fraction.
+// parseInteger fails when the literal has a fraction or overflows.
+bool parseInteger(const char *start, int length, int64_t *value);
+double parseDouble(const char *start, int length);
@@ -1,49 +1,143 @@
+#include "heap.h"
 #include "memory.h"
+#include "number.h"
+#include "output.h"
+#include "utf8.h"
 #include "object.h"
 #include "value.h"
 #include "VM/vm.h"
 
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define ALLOCATE_OBJ(type, objectType) \
     (type*)allocateObject(sizeof(type), objectType)
 
+// Heap new objects are placed in; compile workers swap in their own
+static _Thread_local ObjectHeap *objectHeap = &vm.heap;
+
+ObjectHeap *setObjectHeap(ObjectHeap *heap) {
+    ObjectHeap *previous = objectHeap;
+    objectHeap = heap;
+
+    return previous;
+}
+
+SourceBuffer *newSourceBuffer(char *chars, int length) {
+    // Outside the VM heap and its accounting, like the text it wraps
+    SourceBuffer *source = malloc(sizeof(SourceBuffer));
+    atomic_init(&source->refs, 1);
+    source->length = length;
+    source->chars = chars;
+
+    return source;
+}
+
+void retainSource(SourceBuffer *source) {
+    atomic_fetch_add_explicit(&source->refs, 1, memory_order_relaxed);
+}
+
+void releaseSource(SourceBuffer *source) {
+    if (atomic_fetch_sub_explicit(&source->refs, 1,
+                                  memory_order_acq_rel) > 1)
+        return;
+
+    free(source->chars);
+    free(source);
+}
+
 static Obj *allocateObject(size_t size, ObjType type) {
-    Obj *object = (Obj*)reallocate(NULL, 0, size);
+    Obj *object = heapAllocate(objectHeap, size);
     object->type = type;
-
-    // Link new object at head
-    object->next = vm.objects;
-    vm.objects = object;
+    trackObject(type, size, true);
 
     return object;
 }
 
-static ObjString *allocateString(char *chars, int length) {
+static ObjString *allocateString(char *chars, int length, int codePoints) {
     ObjString *string = ALLOCATE_OBJ(ObjString, OBJ_STRING);
     string->length = length;
+    string->codePoints = codePoints;
+    string->ascii = codePoints == length;
+    string->source = NULL;
     string->chars = chars;
 
     return string;
 }
 
 ObjString *takeString(char *chars, int length) {
-    return allocateString(chars, length);
+    return allocateString(chars, length, countCodePoints(chars, length));
 }
 
 ObjString *copyString(const char *chars, int length) {
-    char *heapChars = ALLOCATE(char, length + 1);
+    return copyCountedString(chars, length, countCodePoints(chars, length));
+}
+
+ObjString *copyCountedString(const char *chars, int length, int codePoints) {
+    char *heapChars = ALLOCATE(char, length + 1, MEM_STRINGS);
     memcpy(heapChars, chars, length);
     heapChars[length] = '\0'; // Terminate string
 
-    return allocateString(heapChars, length);
+    return allocateString(heapChars, length, codePoints);
+}
+
+ObjString *concatenateStrings(ObjString *a, ObjString *b) {
+    int length = a->length + b->length;
+    char *chars = ALLOCATE(char, length + 1, MEM_STRINGS); // + 1 for '\0'
+    memcpy(chars, a->chars, a->length);
+    memcpy(chars + a->length, b->chars, b->length);
+    chars[length] = '\0';
+
+    // Neither side ends mid-sequence, so nothing needs rescanning
+    return allocateString(chars, length, a->codePoints + b->codePoints);
+}
+
+ObjString *viewString(SourceBuffer *source, const char *chars, int length,
+                      int codePoints)
+{
+    ObjString *string = allocateString((char*)chars, length, codePoints);
+    retainSource(source);
+    string->source = source;
+
+    return string;
+}
+
+ObjArray *newArray(int count) {
+    double *values = ALLOCATE(double, count, MEM_ARRAYS);
+    ObjArray *array = ALLOCATE_OBJ(ObjArray, OBJ_ARRAY);
+    array->count = count;
+    array->values = values;
+
+    return array;
+}
+
+ObjArray *copyArray(const double *values, int count) {
+    ObjArray *array = newArray(count);
+    if (count > 0)
+        memcpy(array->values, values, sizeof(double) * count);
+
+    return array;
+}
+
+static void printArray(ObjArray *array) {
+    writeOutput("[", 1);
+    for (int i = 0; i < array->count; i++) {
+        char buffer[NUMBER_BUFFER_SIZE];
+        if (i > 0) writeOutput(", ", 2);
+        writeOutput(buffer, formatDouble(array->values[i], buffer));
+    }
+    writeOutput("]", 1);
 }
 
 void printObject(const Value value) {
     switch (GET_OBJ_TYPE(value)) {
         case OBJ_STRING:
-            printf("%s", AS_CSTRING(value));
+            writeOutput(AS_CHARS(value), AS_STRING(value)->length);
+            break;
+        case OBJ_ARRAY:
+            printArray(AS_ARRAY(value));
             break;
     }
 }
@@ -6,27 +6,72 @@
 #define GET_OBJ_TYPE(value) (AS_OBJ(value)->type)
 
 #define IS_STRING(value) isObjType(value, OBJ_STRING)
+#define IS_ARRAY(value) isObjType(value, OBJ_ARRAY)
 
 #define AS_STRING(value) ((ObjString*)AS_OBJ(value))
-#define AS_CSTRING(value) (((ObjString*)AS_OBJ(value))->chars)
+// Not NUL-terminated when the string is a view; bound it by length
+#define AS_CHARS(value) (((ObjString*)AS_OBJ(value))->chars)
+#define AS_ARRAY(value) ((ObjArray*)AS_OBJ(value))
 
 typedef enum {
     OBJ_STRING,
+    OBJ_ARRAY,
 } ObjType;
 
+#define OBJ_TYPE_COUNT (OBJ_ARRAY + 1)
+
+typedef struct ObjectHeap ObjectHeap;
+
 struct Obj {
     ObjType type;
-    struct Obj* next;
 };
 
+// Script text that string literals point into instead of copying it.
+// Every string viewing it holds a reference, from any thread.
+typedef struct {
+    _Atomic int refs;
+    int length;
+    char *chars; // malloc()ed, freed with the last reference
+} SourceBuffer;
+
+// Always valid UTF-8: literals are checked by the compiler, and joining
+// two valid strings yields one
 struct ObjString {
     Obj obj;
-    int length;
+    int length; // In bytes
+    int codePoints;
+    bool ascii; // Every byte is a code point, so indexing is direct
+    // Owner of chars when the string is a view into script text, which
+    // leaves it unterminated; NULL when the string owns chars
+    SourceBuffer *source;
     char *chars;
 };
 
+// Packed doubles, so kernels can stream through them
+struct ObjArray {
+    Obj obj;
+    int count;
+    double *values;
+};
+
+// Redirects this thread's allocations to heap, returns the old heap
+ObjectHeap *setObjectHeap(ObjectHeap *heap);
+// Takes ownership of chars; the caller holds the first reference
+SourceBuffer *newSourceBuffer(char *chars, int length);
+void retainSource(SourceBuffer *source);
+void releaseSource(SourceBuffer *source);
+// chars must be valid UTF-8
 ObjString *takeString(char *chars, int length);
 ObjString *copyString(const char *chars, int length);
+// For callers that already know the count, e.g. from validateUtf8
+ObjString *copyCountedString(const char *chars, int length, int codePoints);
+ObjString *concatenateStrings(ObjString *a, ObjString *b);
+// Points into source's text rather than copying it
+ObjString *viewString(SourceBuffer *source, const char *chars, int length,
+                      int codePoints);
+// Elements are left uninitialized
+ObjArray *newArray(int count);
+ObjArray *copyArray(const double *values, int count);
 void printObject(const Value value);
 
 static inline bool isObjType(Value value, ObjType type) {
@@ -0,0 +1,105 @@
+#include "output.h"
+#include "memory.h"
+#include "VM/vm.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Compile workers print through their own buffers
+static _Thread_local Output *current = &vm.output;
+
+void initOutput(Output *output, size_t capacity) {
+    output->buffer = NULL;
+    output->count = 0;
+    output->capacity = capacity;
+    output->sink = NULL;
+    output->context = NULL;
+}
+
+static void emit(Output *output, const char *data, size_t length) {
+    if (length == 0) return;
+
+    if (output->sink != NULL) {
+        output->sink(data, length, output->context);
+    }
+    else {
+        fwrite(data, 1, length, stdout);
+        fflush(stdout);
+    }
+}
+
+static void flush(Output *output) {
+    emit(output, output->buffer, output->count);
+    output->count = 0;
+}
+
+void freeOutput(Output *output) {
+    flush(output);
+    FREE_ARRAY(char, output->buffer, output->capacity, MEM_OUTPUT);
+    output->buffer = NULL;
+}
+
+Output *setOutput(Output *newOutput) {
+    Output *previous = current;
+    current = newOutput;
+
+    return previous;
+}
+
+void setOutputSink(OutputSink sink, void *context) {
+    flush(current);
+    current->sink = sink;
+    current->context = context;
+}
+
+void setOutputCapacity(size_t capacity) {
+    freeOutput(current);
+    current->capacity = capacity;
+}
+
+void writeOutput(const char *data, size_t length) {
+    if (current->count + length > current->capacity) {
+        flush(current);
+
+        // Too big to ever buffer
+        if (length > current->capacity) {
+            emit(current, data, length);
+            return;
+        }
+    }
+
+    if (current->buffer == NULL)
+        current->buffer = ALLOCATE(char, current->capacity, MEM_OUTPUT);
+
+    memcpy(current->buffer + current->count, data, length);
+    current->count += length;
+}
+
+void printOutput(const char *format, ...) {
+    char local[256];
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(local, sizeof(local), format, args);
+    va_end(args);
+    if (length < 0) return;
+
+    if ((size_t)length < sizeof(local)) {
+        writeOutput(local, length);
+        return;
+    }
+
+    char *text = malloc(length + 1);
+    va_start(args, format);
+    vsnprintf(text, length + 1, format, args);
+    va_end(args);
+
+    writeOutput(text, length);
+    free(text);
+}
+
+void flushOutput() {
+    flush(current);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "common.h"
+
+#include <stddef.h>
+
+#define OUTPUT_BUFFER_DEFAULT (64 * 1024)
+
+// Receives each flushed block of program output
+typedef void (*OutputSink)(const char *data, size_t length, void *context);
+
+typedef struct {
+    char *buffer; // Allocated on first write
+    size_t count;
+    size_t capacity; // 0 hands every write straight to the sink
+    OutputSink sink; // NULL writes to stdout
+    void *context;
+} Output;
+
+void initOutput(Output *output, size_t capacity);
+// Flushes, then releases the buffer
+void freeOutput(Output *output);
+// Redirects this thread's printing to output, returns the old output
+Output *setOutput(Output *output);
+void setOutputSink(OutputSink sink, void *context);
+void setOutputCapacity(size_t capacity);
+void writeOutput(const char *data, size_t length);
+void printOutput(const char *format, ...);
+void flushOutput();
@@ -0,0 +1,64 @@
+#include "sequence.h"
+#include "object.h"
+#include "utf8.h"
+
+const char *sequenceLength(Value sequence, Value *result) {
+    if (IS_STRING(sequence)) {
+        *result = MAKE_INT_VAL(AS_STRING(sequence)->codePoints);
+    }
+    else if (IS_ARRAY(sequence)) {
+        *result = MAKE_INT_VAL(AS_ARRAY(sequence)->count);
+    }
+    else {
+        return "Operand must be a string or an array.";
+    }
+
+    return NULL;
+}
+
+// Integral doubles index too, so results of arithmetic on arrays do.
+// Returns NULL or the error message.
+static const char *toIndex(Value index, int count, int *position) {
+    if (!IS_NUMBER(index)) return "Index must be a number.";
+
+    double number = AS_NUMBER(index);
+    if (!(number >= 0 && number < count)) return "Index out of range.";
+
+    *position = (int)number;
+    if ((double)*position != number) return "Index must be an integer.";
+
+    return NULL;
+}
+
+const char *sequenceIndex(Value sequence, Value index, Value *result) {
+    int position;
+    const char *error;
+    if (IS_STRING(sequence)) {
+        ObjString *string = AS_STRING(sequence);
+        error = toIndex(index, string->codePoints, &position);
+        if (error != NULL) return error;
+
+        if (string->ascii) {
+            *result = MAKE_OBJ_VAL(copyString(string->chars + position, 1));
+        }
+        else {
+            int offset = codePointOffset(string->chars, string->length,
+                                         position);
+            *result = MAKE_OBJ_VAL(copyString(
+                string->chars + offset,
+                codePointLength(string->chars[offset])));
+        }
+    }
+    else if (IS_ARRAY(sequence)) {
+        ObjArray *array = AS_ARRAY(sequence);
+        error = toIndex(index, array->count, &position);
+        if (error != NULL) return error;
+
+        *result = MAKE_NUMBER_VAL(array->values[position]);
+    }
+    else {
+        return "Only strings and arrays can be indexed.";
+    }
+
+    return NULL;
+}
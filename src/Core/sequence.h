@@ -0,0 +1,12 @@
+#pragma once
+
+#include "common.h"
+#include "value.h"
+
+// len() and indexing, shared by the VM and generated C. Strings count
+// code points, arrays elements. Each returns NULL on success or the
+// runtime error message, leaving result untouched.
+
+const char *sequenceLength(Value sequence, Value *result);
+// A one-character string, or an array element as a number
+const char *sequenceIndex(Value sequence, Value index, Value *result);
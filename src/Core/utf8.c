@@ -0,0 +1,180 @@
+#include "utf8.h"
+#include "cpu.h"
+
+// One ISA's kernels
+typedef struct {
+    // Length of the leading run of ASCII bytes
+    int (*asciiPrefix)(const unsigned char *bytes, int length);
+    // Bytes that start a code point, i.e. are not 10xxxxxx
+    int (*countLeads)(const unsigned char *bytes, int length);
+} Kernels;
+
+static int asciiPrefixScalar(const unsigned char *bytes, int length) {
+    int i = 0;
+    while (i < length && bytes[i] < 0x80) i++;
+
+    return i;
+}
+
+static int countLeadsScalar(const unsigned char *bytes, int length) {
+    int count = 0;
+    for (int i = 0; i < length; i++) count += (bytes[i] & 0xC0) != 0x80;
+
+    return count;
+}
+
+#ifndef HAS_SIMD
+
+static const Kernels scalarKernels = {asciiPrefixScalar, countLeadsScalar};
+
+#else
+
+static int asciiPrefixSse2(const unsigned char *bytes, int length) {
+    int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        // movemask gathers the top bit of every byte
+        int high = _mm_movemask_epi8(
+            _mm_loadu_si128((const __m128i*)(bytes + i)));
+        if (high != 0) return i + __builtin_ctz(high);
+    }
+
+    return i + asciiPrefixScalar(bytes + i, length - i);
+}
+
+static int countLeadsSse2(const unsigned char *bytes, int length) {
+    // Continuation bytes are exactly the signed bytes below -64
+    __m128i threshold = _mm_set1_epi8(-65);
+    int count = 0;
+    int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(bytes + i));
+        count += __builtin_popcount(
+            _mm_movemask_epi8(_mm_cmpgt_epi8(chunk, threshold)));
+    }
+
+    return count + countLeadsScalar(bytes + i, length - i);
+}
+
+static const Kernels sse2Kernels = {asciiPrefixSse2, countLeadsSse2};
+
+AVX2 static int asciiPrefixAvx2(const unsigned char *bytes, int length) {
+    int i = 0;
+    for (; i + 32 <= length; i += 32) {
+        unsigned high = (unsigned)_mm256_movemask_epi8(
+            _mm256_loadu_si256((const __m256i*)(bytes + i)));
+        if (high != 0) return i + __builtin_ctz(high);
+    }
+
+    return i + asciiPrefixSse2(bytes + i, length - i);
+}
+
+AVX2 static int countLeadsAvx2(const unsigned char *bytes, int length) {
+    __m256i threshold = _mm256_set1_epi8(-65);
+    int count = 0;
+    int i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(bytes + i));
+        count += __builtin_popcount((unsigned)_mm256_movemask_epi8(
+            _mm256_cmpgt_epi8(chunk, threshold)));
+    }
+
+    return count + countLeadsSse2(bytes + i, length - i);
+}
+
+static const Kernels avx2Kernels = {asciiPrefixAvx2, countLeadsAvx2};
+
+#endif
+
+static const Kernels *kernels() {
+#ifdef HAS_SIMD
+    return cpuHasAvx2() ? &avx2Kernels : &sse2Kernels;
+#else
+    return &scalarKernels;
+#endif
+}
+
+// Length of the well-formed multi-byte sequence at bytes, 0 if there is
+// none. The second byte's range rules out overlong forms, surrogates and
+// code points past U+10FFFF.
+static int validSequence(const unsigned char *bytes, int remaining) {
+    unsigned char lead = bytes[0];
+    int length;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+
+    if (lead < 0xC2) {
+        return 0; // Stray continuation byte or overlong 2-byte form
+    }
+    else if (lead < 0xE0) {
+        length = 2;
+    }
+    else if (lead < 0xF0) {
+        length = 3;
+        if (lead == 0xE0) low = 0xA0;
+        if (lead == 0xED) high = 0x9F;
+    }
+    else if (lead < 0xF5) {
+        length = 4;
+        if (lead == 0xF0) low = 0x90;
+        if (lead == 0xF4) high = 0x8F;
+    }
+    else {
+        return 0;
+    }
+
+    if (remaining < length || bytes[1] < low || bytes[1] > high) return 0;
+    for (int i = 2; i < length; i++) {
+        if ((bytes[i] & 0xC0) != 0x80) return 0;
+    }
+
+    return length;
+}
+
+bool validateUtf8(const char *chars, int length, int *codePoints) {
+    const unsigned char *bytes = (const unsigned char*)chars;
+    const Kernels *selected = kernels();
+    int count = 0;
+    int i = 0;
+
+    while (i < length) {
+        int ascii = selected->asciiPrefix(bytes + i, length - i);
+        i += ascii;
+        count += ascii;
+        if (i == length) break;
+
+        int sequence = validSequence(bytes + i, length - i);
+        if (sequence == 0) return false;
+        i += sequence;
+        count++;
+    }
+
+    *codePoints = count;
+    return true;
+}
+
+int countCodePoints(const char *chars, int length) {
+    return kernels()->countLeads((const unsigned char*)chars, length);
+}
+
+int codePointOffset(const char *chars, int length, int index) {
+    const unsigned char *bytes = (const unsigned char*)chars;
+    const Kernels *selected = kernels();
+
+    // Skip whole blocks that end before the code point, then walk
+    int offset = 0;
+    int block = 64;
+    while (offset + block <= length) {
+        int leads = selected->countLeads(bytes + offset, block);
+        if (leads > index) break;
+        index -= leads;
+        offset += block;
+    }
+
+    for (;; offset++) {
+        if ((bytes[offset] & 0xC0) == 0x80) continue;
+        if (index == 0) break;
+        index--;
+    }
+
+    return offset;
+}
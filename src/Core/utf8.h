@@ -0,0 +1,20 @@
+#pragma once
+
+#include "common.h"
+
+// UTF-8 scanning for string literals and character-wise string access.
+// Runs of ASCII are skipped 16 or 32 bytes at a time.
+
+// False when chars is not well-formed UTF-8 (RFC 3629: no overlong
+// forms, surrogates or code points past U+10FFFF); otherwise stores
+// how many code points it holds
+bool validateUtf8(const char *chars, int length, int *codePoints);
+// chars must be valid UTF-8
+int countCodePoints(const char *chars, int length);
+// Byte offset of code point index, which must be below the count
+int codePointOffset(const char *chars, int length, int index);
+// Bytes in the sequence led by lead
+static inline int codePointLength(char lead) {
+    unsigned char byte = (unsigned char)lead;
+    return byte < 0xE0 ? (byte < 0x80 ? 1 : 2) : (byte < 0xF0 ? 3 : 4);
+}
@@ -1,4 +1,6 @@
 #include "memory.h"
+#include "number.h"
+#include "output.h"
 #include "value.h"
 #include "object.h"
 
@@ -19,7 +21,8 @@ void writeValueArray(ValueArray *array, Value value) {
             Value,
             array->values, 
             oldCapacity, 
-            array->capacity
+            array->capacity,
+            MEM_CONSTANTS
         );
     }
 
@@ -28,17 +31,29 @@ void writeValueArray(ValueArray *array, Value value) {
 }
 
 void freeValueArray(ValueArray *array) {
-    FREE_ARRAY(Value, array->values, array->capacity);
+    FREE_ARRAY(Value, array->values, array->capacity, MEM_CONSTANTS);
     initValueArray(array);
 }
 
 void printValue(Value value) {
     switch (value.type) {
         case VAL_BOOL:
-            printf(AS_BOOL(value) ? "true" : "false");
+            if (AS_BOOL(value)) writeOutput("true", 4);
+            else writeOutput("false", 5);
             break;
-        case VAL_NIL: printf("nil"); break;
-        case VAL_NUMBER: printf("%g", AS_NUMBER(value)); break;
+        case VAL_NIL: writeOutput("nil", 3); break;
+        case VAL_NUMBER: {
+            char buffer[NUMBER_BUFFER_SIZE];
+            int length = formatDouble(AS_DOUBLE(value), buffer);
+            writeOutput(buffer, length);
+            break;
+        }
+        case VAL_INT: {
+            char buffer[NUMBER_BUFFER_SIZE];
+            int length = formatInteger(AS_INT(value), buffer);
+            writeOutput(buffer, length);
+            break;
+        }
         case VAL_OBJ: {
             ObjString *astring;
             printObject(value); 
@@ -48,15 +63,11 @@ void printValue(Value value) {
     }
 }
 
-bool valuesEqual(Value a, Value b) {
-    if (a.type != b.type)
-        return false;
+static bool objectsEqual(Value a, Value b) {
+    if (GET_OBJ_TYPE(a) != GET_OBJ_TYPE(b)) return false;
 
-    switch (a.type) {
-        case VAL_BOOL: return AS_BOOL(a) == AS_BOOL(b);
-        case VAL_NIL: return true;
-        case VAL_NUMBER: return AS_NUMBER(a) == AS_NUMBER(b);
-        case VAL_OBJ: {
+    switch (GET_OBJ_TYPE(a)) {
+        case OBJ_STRING: {
             ObjString *aString = AS_STRING(a);
             ObjString *bString = AS_STRING(b);
 
@@ -65,6 +76,38 @@ bool valuesEqual(Value a, Value b) {
                 (memcmp(aString->chars, bString->chars, aString->length) == 0)
             );
         }
+        case OBJ_ARRAY: {
+            // Element-wise like numbers, so -0 equals 0 and NaN nothing
+            ObjArray *aArray = AS_ARRAY(a);
+            ObjArray *bArray = AS_ARRAY(b);
+            if (aArray->count != bArray->count) return false;
+
+            for (int i = 0; i < aArray->count; i++) {
+                if (aArray->values[i] != bArray->values[i]) return false;
+            }
+            return true;
+        }
+    }
+
+    return false; // Unreachable.
+}
+
+bool valuesEqual(Value a, Value b) {
+    // Numbers compare by value whatever their representation
+    if (IS_NUMBER(a) && IS_NUMBER(b)) {
+        if (IS_INT(a) && IS_INT(b))
+            return AS_INT(a) == AS_INT(b);
+
+        return AS_NUMBER(a) == AS_NUMBER(b);
+    }
+
+    if (a.type != b.type)
+        return false;
+
+    switch (a.type) {
+        case VAL_BOOL: return AS_BOOL(a) == AS_BOOL(b);
+        case VAL_NIL: return true;
+        case VAL_OBJ: return objectsEqual(a, b);
         default: return false; // Unreachable.
     }
 }
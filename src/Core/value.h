@@ -4,11 +4,13 @@
 
 typedef struct Obj Obj;
 typedef struct ObjString ObjString;
+typedef struct ObjArray ObjArray;
 
 typedef enum {
     VAL_BOOL,
     VAL_NIL,
-    VAL_NUMBER,
+    VAL_NUMBER, // Double
+    VAL_INT, // Integral number, promoted to double on overflow
     VAL_OBJ,
 } ValueType;
 
@@ -17,6 +19,7 @@ typedef struct {
     union {
         bool boolean;
         double number;
+        int64_t integer;
         Obj *obj;
     } as;
 } Value;
@@ -25,19 +28,39 @@ typedef struct {
 #define MAKE_BOOL_VAL(value)   ((Value){VAL_BOOL, {.boolean = value}})
 #define MAKE_NIL_VAL           ((Value){VAL_NIL, {.number = 0}})
 #define MAKE_NUMBER_VAL(value) ((Value){VAL_NUMBER, {.number = value}})
+#define MAKE_INT_VAL(value)    ((Value){VAL_INT, {.integer = value}})
 #define MAKE_OBJ_VAL(object)   ((Value){VAL_OBJ, {.obj = (Obj*)object}})
 
 // Value accessor macro
 #define AS_BOOL(value)   ((value).as.boolean)
-#define AS_NUMBER(value) ((value).as.number)
+#define AS_NUMBER(value) asNumber(value)
+#define AS_INT(value)    ((value).as.integer)
+#define AS_DOUBLE(value) ((value).as.number)
 #define AS_OBJ(value)    ((value).as.obj)
 
 // Value type check macro
 #define IS_BOOL(value) ((value).type == VAL_BOOL)
 #define IS_NIL(value) ((value).type == VAL_NIL)
-#define IS_NUMBER(value) ((value).type == VAL_NUMBER)
+#define IS_DOUBLE(value) ((value).type == VAL_NUMBER)
+#define IS_INT(value) ((value).type == VAL_INT)
+// Either number representation
+#define IS_NUMBER(value) (IS_DOUBLE(value) || IS_INT(value))
 #define IS_OBJ(value) ((value).type == VAL_OBJ)
 
+// Reads either number representation as a double
+static inline double asNumber(Value value) {
+    return IS_INT(value) ? (double)AS_INT(value) : AS_DOUBLE(value);
+}
+
+// Like __builtin_mul_overflow, but also true for a zero product with a
+// negative operand, which as doubles is -0 and has no int form
+static inline bool intMultiplyOverflow(int64_t a, int64_t b,
+                                       int64_t *result)
+{
+    return __builtin_mul_overflow(a, b, result) ||
+           (*result == 0 && (a < 0 || b < 0));
+}
+
 typedef struct {
     int capacity;
     int count;
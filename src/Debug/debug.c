@@ -1,12 +1,13 @@
 #include "debug.h"
 #include "Chunk/chunk.h"
+#include "Core/output.h"
 #include "Core/value.h"
 
 #include <stdint.h>
 #include <stdio.h>
 
 void disassembleChunk(Chunk *chunk, const char *name) {
-    printf("== %s ==\n", name);
+    printOutput("== %s ==\n", name);
 
     for (int offset=0; offset < chunk->count;) {
         // Offest of next opcode
@@ -15,30 +16,37 @@ void disassembleChunk(Chunk *chunk, const char *name) {
 }
 
 static int simpleInstruction(const char *name, int offset) {
-    printf("%s\n", name);
+    printOutput("%s\n", name);
 
     return offset + 1;
 }
 
 static int constantInstruction(const char *name, Chunk *chunk, int offset) {
     uint8_t constant = chunk->code[offset + 1]; // constant is after opcode
-    printf("%-16s %4d '", name, constant);
+    printOutput("%-16s %4d '", name, constant);
     printValue(chunk->constants.values[constant]);
-    printf("'\n");
+    printOutput("'\n");
 
     return offset + 2; // One for opcode and the other for operand
 }
 
+static int byteInstruction(const char *name, Chunk *chunk, int offset) {
+    uint8_t slot = chunk->code[offset + 1];
+    printOutput("%-16s %4d\n", name, slot);
+
+    return offset + 2;
+}
+
 int disassembleInstruction(Chunk *chunk, int offset) {
-    printf("%04d ", offset);
+    printOutput("%04d ", offset);
 
     if (offset > 0 &&
         chunk->lines[offset] == chunk->lines[offset - 1]) 
     {
-        printf("   | ");
+        printOutput("   | ");
     }
     else {
-        printf("%4d ", chunk->lines[offset]);
+        printOutput("%4d ", chunk->lines[offset]);
     }
 
     uint8_t instruction = chunk->code[offset];
@@ -69,10 +77,70 @@ int disassembleInstruction(Chunk *chunk, int offset) {
             return simpleInstruction("OP_NOT", offset);
         case OP_NEGATE:
             return simpleInstruction("OP_NEGATE", offset);
+        case OP_SUM:
+            return simpleInstruction("OP_SUM", offset);
+        case OP_DOT:
+            return simpleInstruction("OP_DOT", offset);
+        case OP_MIN:
+            return simpleInstruction("OP_MIN", offset);
+        case OP_MAX:
+            return simpleInstruction("OP_MAX", offset);
+        case OP_RANGE:
+            return simpleInstruction("OP_RANGE", offset);
+        case OP_LENGTH:
+            return simpleInstruction("OP_LENGTH", offset);
+        case OP_INDEX:
+            return simpleInstruction("OP_INDEX", offset);
+        case OP_GET_LOCAL:
+            return byteInstruction("OP_GET_LOCAL", chunk, offset);
+        case OP_SET_LOCAL:
+            return byteInstruction("OP_SET_LOCAL", chunk, offset);
+        case OP_COLUMN:
+            return byteInstruction("OP_COLUMN", chunk, offset);
         case OP_RETURN:
             return simpleInstruction("OP_RETURN", offset);
+        case OP_ADD_NN:
+            return simpleInstruction("OP_ADD_NN", offset);
+        case OP_SUBTRACT_NN:
+            return simpleInstruction("OP_SUBTRACT_NN", offset);
+        case OP_MULTIPLY_NN:
+            return simpleInstruction("OP_MULTIPLY_NN", offset);
+        case OP_DIVIDE_NN:
+            return simpleInstruction("OP_DIVIDE_NN", offset);
+        case OP_LESS_NN:
+            return simpleInstruction("OP_LESS_NN", offset);
+        case OP_GREATER_NN:
+            return simpleInstruction("OP_GREATER_NN", offset);
+        case OP_NEGATE_N:
+            return simpleInstruction("OP_NEGATE_N", offset);
+        case OP_CONCAT:
+            return simpleInstruction("OP_CONCAT", offset);
+        case OP_ADD_INT:
+            return simpleInstruction("OP_ADD_INT", offset);
+        case OP_ADD_NUM:
+            return simpleInstruction("OP_ADD_NUM", offset);
+        case OP_ADD_STR:
+            return simpleInstruction("OP_ADD_STR", offset);
+        case OP_SUBTRACT_INT:
+            return simpleInstruction("OP_SUBTRACT_INT", offset);
+        case OP_SUBTRACT_NUM:
+            return simpleInstruction("OP_SUBTRACT_NUM", offset);
+        case OP_MULTIPLY_INT:
+            return simpleInstruction("OP_MULTIPLY_INT", offset);
+        case OP_MULTIPLY_NUM:
+            return simpleInstruction("OP_MULTIPLY_NUM", offset);
+        case OP_DIVIDE_NUM:
+            return simpleInstruction("OP_DIVIDE_NUM", offset);
+        case OP_LESS_INT:
+            return simpleInstruction("OP_LESS_INT", offset);
+        case OP_LESS_NUM:
+            return simpleInstruction("OP_LESS_NUM", offset);
+        case OP_GREATER_INT:
+            return simpleInstruction("OP_GREATER_INT", offset);
+        case OP_GREATER_NUM:
+            return simpleInstruction("OP_GREATER_NUM", offset);
         default:
-            printf("Unknown opcode %d\n", instruction);
+            printOutput("Unknown opcode %d\n", instruction);
             return offset + 1;
     }
 }
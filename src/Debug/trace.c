@@ -0,0 +1,281 @@
+#include "trace.h"
+#include "Chunk/chunk.h"
+#include "Core/memory.h"
+#include "Core/output.h"
+#include "Frontend/compiler.h"
+#include "debug.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TRACE_MAGIC "CLOXTRCE"
+#define TRACE_VERSION 1
+
+// Dump layout: this header, then count records, oldest first. The two
+// clock pairs let the decoder turn ticks into nanoseconds.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t count;
+    uint64_t written; // Records ever written, count of them survived
+    uint64_t startTicks;
+    uint64_t dumpTicks;
+    int64_t startNanoseconds;
+    int64_t dumpNanoseconds;
+} TraceHeader;
+
+// Signal handlers can only reach the ring through a global
+static TraceRing *signalRing = NULL;
+static const int fatalSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+static int64_t nanoseconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (int64_t)time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+static void onSignal(int signal) {
+    int savedErrno = errno;
+    dumpTrace(signalRing);
+    errno = savedErrno;
+
+    // The handler was reset on entry, so this dies as it would have
+    if (signal != SIGUSR1) raise(signal);
+}
+
+static void handleSignals(bool enabled) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = enabled ? onSignal : SIG_DFL;
+
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+
+    action.sa_flags = SA_RESETHAND;
+    for (size_t i = 0; i < sizeof(fatalSignals) / sizeof(int); i++)
+        sigaction(fatalSignals[i], &action, NULL);
+}
+
+TraceRing *newTraceRing(uint32_t capacity, const char *path) {
+    uint32_t rounded = 1;
+    while (rounded < capacity) rounded <<= 1;
+
+    TraceRing *ring = ALLOCATE(TraceRing, 1, MEM_TRACE);
+    ring->records = ALLOCATE(TraceRecord, rounded, MEM_TRACE);
+    ring->capacity = rounded;
+    atomic_init(&ring->head, 0);
+    ring->startTicks = traceTicks();
+    ring->startNanoseconds = nanoseconds();
+    ring->path = path;
+
+    signalRing = ring;
+    handleSignals(true);
+
+    return ring;
+}
+
+void freeTraceRing(TraceRing *ring) {
+    if (signalRing == ring) {
+        handleSignals(false);
+        signalRing = NULL;
+    }
+
+    FREE_ARRAY(TraceRecord, ring->records, ring->capacity, MEM_TRACE);
+    FREE(TraceRing, ring, MEM_TRACE);
+}
+
+static bool writeAll(int fd, const void *data, size_t size) {
+    const char *bytes = data;
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+
+        bytes += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+// Only open, write and clock_gettime, so signal handlers can call it.
+// A record being written when the signal arrived may come out torn.
+bool dumpTrace(TraceRing *ring) {
+    if (ring == NULL) return false;
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t count = head < ring->capacity ? head : ring->capacity;
+
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.recordSize = sizeof(TraceRecord);
+    header.count = count;
+    header.written = head;
+    header.startTicks = ring->startTicks;
+    header.startNanoseconds = ring->startNanoseconds;
+    header.dumpTicks = traceTicks();
+    header.dumpNanoseconds = nanoseconds();
+
+    int fd = open(ring->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    // Oldest first: from the oldest slot to the end, then wrap around
+    uint64_t first = (head - count) & (ring->capacity - 1);
+    uint64_t firstSpan = ring->capacity - first;
+    if (firstSpan > count) firstSpan = count;
+
+    bool written = writeAll(fd, &header, sizeof(header)) &&
+        writeAll(fd, &ring->records[first], firstSpan * sizeof(TraceRecord)) &&
+        writeAll(fd, ring->records, (count - firstSpan) * sizeof(TraceRecord));
+
+    close(fd);
+    return written;
+}
+
+// Like main's readFile, but returns NULL after reporting a failure
+// instead of exiting
+static char *readScript(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file \"%s\".\n", path);
+        return NULL;
+    }
+
+    long size = -1;
+    if (fseek(file, 0L, SEEK_END) == 0) size = ftell(file);
+    rewind(file);
+    if (size < 0) {
+        fprintf(stderr, "Could not read file \"%s\".\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    char *buffer = (char*)malloc((size_t)size + 1);
+    if (buffer == NULL) {
+        fprintf(stderr, "Not enough memory to read \"%s\".\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    size_t bytesRead = fread(buffer, sizeof(char), (size_t)size, file);
+    fclose(file);
+    if (bytesRead < (size_t)size) {
+        fprintf(stderr, "Could not read file \"%s\".\n", path);
+        free(buffer);
+        return NULL;
+    }
+
+    buffer[bytesRead] = '\0';
+    return buffer;
+}
+
+static bool readRecords(FILE *file, TraceHeader *header,
+                        TraceRecord **records)
+{
+    if (fread(header, sizeof(*header), 1, file) != 1 ||
+        memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TRACE_VERSION ||
+        header->recordSize != sizeof(TraceRecord) ||
+        header->count > header->written)
+    {
+        return false;
+    }
+
+    *records = ALLOCATE(TraceRecord, header->count, MEM_TRACE);
+    if (fread(*records, sizeof(TraceRecord), header->count, file) !=
+        header->count)
+    {
+        FREE_ARRAY(TraceRecord, *records, header->count, MEM_TRACE);
+        return false;
+    }
+
+    return true;
+}
+
+// Disassembles the instruction at offset as the opcode it ran as
+static void renderRecord(Chunk *chunk, TraceRecord *record) {
+    uint32_t offset = record->offset;
+    uint8_t original = chunk->code[offset];
+    int size = instructionSize(chunk, offset);
+
+    chunk->code[offset] = record->opcode;
+    // A quickened form has its generic instruction's size; anything
+    // else means the dump came from another script
+    if (instructionSize(chunk, offset) == size) {
+        disassembleInstruction(chunk, offset);
+    }
+    else {
+        printOutput("opcode %d does not fit offset %u\n",
+                    record->opcode, offset);
+    }
+    chunk->code[offset] = original;
+}
+
+int decodeTrace(const char *tracePath, const char *scriptPath) {
+    FILE *file = fopen(tracePath, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file \"%s\".\n", tracePath);
+        return 74; // I/0 error
+    }
+
+    TraceHeader header;
+    TraceRecord *records;
+    bool valid = readRecords(file, &header, &records);
+    fclose(file);
+    if (!valid) {
+        fprintf(stderr, "Invalid trace \"%s\".\n", tracePath);
+        return 65; // Data error
+    }
+
+    char *source = readScript(scriptPath);
+    if (source == NULL) {
+        FREE_ARRAY(TraceRecord, records, header.count, MEM_TRACE);
+        return 74;
+    }
+
+    // Compiling is deterministic, so every chunk in the trace has the
+    // code this produces, less quickening
+    Chunk chunk;
+    initChunk(&chunk);
+    bool compiled = compile(source, &chunk);
+    free(source);
+
+    if (compiled) {
+        double ticksPerNanosecond = 1.0;
+        if (header.dumpNanoseconds > header.startNanoseconds) {
+            ticksPerNanosecond =
+                (double)(header.dumpTicks - header.startTicks) /
+                (double)(header.dumpNanoseconds - header.startNanoseconds);
+        }
+
+        printOutput("== trace: last %llu of %llu instructions ==\n",
+                    (unsigned long long)header.count,
+                    (unsigned long long)header.written);
+        for (uint64_t i = 0; i < header.count; i++) {
+            TraceRecord *record = &records[i];
+            double micros = (double)(record->ticks - records[0].ticks) /
+                            ticksPerNanosecond / 1e3;
+            printOutput("%12.3f us  chunk %5u  depth %3u  ", micros,
+                        record->chunk, record->depth);
+
+            if (record->offset >= (uint32_t)chunk.count) {
+                printOutput("offset %u out of range\n", record->offset);
+                continue;
+            }
+            renderRecord(&chunk, record);
+        }
+    }
+
+    freeChunk(&chunk);
+    FREE_ARRAY(TraceRecord, records, header.count, MEM_TRACE);
+    return compiled ? 0 : 65;
+}
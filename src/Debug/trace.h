@@ -0,0 +1,65 @@
+#pragma once
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <time.h>
+
+#define TRACE_RING_DEFAULT 4096
+#define TRACE_FILE_DEFAULT "clox-trace.bin"
+
+// One executed instruction, recorded before it runs
+typedef struct {
+    uint64_t ticks; // Timestamp counter, calibrated in the dump header
+    uint32_t offset; // Into the chunk's code
+    uint16_t chunk; // vm.chunkId of the chunk that ran
+    uint8_t opcode; // As executed, so quickened forms show up
+    uint8_t depth; // Stack depth, saturating at 255
+} TraceRecord;
+
+// Fixed-size ring the VM thread writes without locking. head only ever
+// grows, so a reader, such as a signal handler, can find the newest
+// records from it alone.
+typedef struct {
+    TraceRecord *records;
+    uint32_t capacity; // A power of two
+    _Atomic uint64_t head; // Records written so far
+    uint64_t startTicks;
+    int64_t startNanoseconds;
+    const char *path; // Where dumps go
+} TraceRing;
+
+static inline uint64_t traceTicks() {
+#if defined(__x86_64__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000u + time.tv_nsec;
+#endif
+}
+
+static inline void recordTrace(TraceRing *ring, uint16_t chunk,
+                               uint32_t offset, uint8_t opcode, int depth)
+{
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    TraceRecord *record = &ring->records[head & (ring->capacity - 1)];
+    record->ticks = traceTicks();
+    record->offset = offset;
+    record->chunk = chunk;
+    record->opcode = opcode;
+    record->depth = depth > UINT8_MAX ? UINT8_MAX : (uint8_t)depth;
+    // Publishes the record to readers that acquire head
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// Holds the last capacity records, rounded up to a power of two, and
+// dumps them to path on runtime errors, SIGUSR1 and fatal signals
+TraceRing *newTraceRing(uint32_t capacity, const char *path);
+void freeTraceRing(TraceRing *ring);
+// Async-signal-safe; returns false when the file could not be written
+bool dumpTrace(TraceRing *ring);
+// Renders a dump against the script that produced it, returns an exit
+// status
+int decodeTrace(const char *tracePath, const char *scriptPath);
@@ -0,0 +1,242 @@
+#include "bulk.h"
+#include "Chunk/chunk.h"
+#include "Core/heap.h"
+#include "Core/memory.h"
+#include "Core/object.h"
+#include "Core/output.h"
+#include "compiler.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+typedef struct {
+    char *path;
+    bool compiled;
+    long sourceBytes;
+    int codeBytes;
+    long long nanoseconds;
+} CompileJob;
+
+typedef struct {
+    CompileJob *jobs;
+    int count;
+    int capacity;
+    atomic_int next; // Index of the next unclaimed job
+} JobQueue;
+
+static long long now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (long long)time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+// Like main's readFile, but returns NULL after reporting a failure
+// instead of exiting
+static char *readSource(const char *path, long *size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file \"%s\".\n", path);
+        return NULL;
+    }
+
+    long fileSize = -1;
+    if (fseek(file, 0L, SEEK_END) == 0) fileSize = ftell(file);
+    rewind(file);
+    if (fileSize < 0) {
+        fprintf(stderr, "Could not read file \"%s\".\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    char *buffer = (char*)malloc((size_t)fileSize + 1);
+    if (buffer == NULL) {
+        fprintf(stderr, "Not enough memory to read \"%s\".\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    size_t bytesRead = fread(buffer, sizeof(char), (size_t)fileSize, file);
+    fclose(file);
+    if (bytesRead < (size_t)fileSize) {
+        fprintf(stderr, "Could not read file \"%s\".\n", path);
+        free(buffer);
+        return NULL;
+    }
+
+    buffer[bytesRead] = '\0';
+    *size = fileSize;
+    return buffer;
+}
+
+// A file that cannot be read is reported as a FAIL
+static void compileJob(CompileJob *job) {
+    char *source = readSource(job->path, &job->sourceBytes);
+    if (source == NULL) return;
+
+    Chunk chunk;
+    initChunk(&chunk);
+
+    long long start = now();
+    job->compiled = compile(source, &chunk);
+    job->nanoseconds = now() - start;
+    job->codeBytes = chunk.count;
+
+    freeChunk(&chunk);
+    free(source);
+}
+
+static void *worker(void *argument) {
+    JobQueue *queue = argument;
+
+    // Constants allocated while compiling stay on this thread's list, and
+    // are accounted apart from the VM's heap
+    ObjectHeap heap;
+    initHeap(&heap);
+    ObjectHeap *previousHeap = setObjectHeap(&heap);
+    MemoryStats stats = {0};
+    MemoryStats *previousStats = setMemoryStats(&stats);
+    // Buffered per thread so each file's listing comes out in one piece
+    Output output;
+    initOutput(&output, OUTPUT_BUFFER_DEFAULT);
+    Output *previousOutput = setOutput(&output);
+
+    for (;;) {
+        int index = atomic_fetch_add(&queue->next, 1);
+        if (index >= queue->count) break;
+
+        compileJob(&queue->jobs[index]);
+        flushOutput();
+        freeHeap(&heap);
+    }
+
+    freeOutput(&output);
+    // Restored for when this ran on the main thread
+    setOutput(previousOutput);
+    setMemoryStats(previousStats);
+    setObjectHeap(previousHeap);
+    return NULL;
+}
+
+static int compareJobs(const void *a, const void *b) {
+    return strcmp(((const CompileJob*)a)->path, ((const CompileJob*)b)->path);
+}
+
+static bool hasLoxExtension(const char *name) {
+    size_t length = strlen(name);
+
+    return length > 4 && strcmp(name + length - 4, ".lox") == 0;
+}
+
+// Queues the regular .lox files in directory; false after reporting
+// why it could not
+static bool listSources(const char *directory, JobQueue *queue) {
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        fprintf(stderr, "Could not open directory \"%s\".\n", directory);
+        return false;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!hasLoxExtension(entry->d_name)) continue;
+
+        size_t length = strlen(directory) + strlen(entry->d_name) + 2;
+        char *path = malloc(length);
+        if (path == NULL) {
+            fprintf(stderr, "Not enough memory to list \"%s\".\n",
+                    directory);
+            closedir(dir);
+            return false;
+        }
+        snprintf(path, length, "%s/%s", directory, entry->d_name);
+
+        // Directories and the like named *.lox are not scripts
+        struct stat info;
+        if (stat(path, &info) != 0 || !S_ISREG(info.st_mode)) {
+            free(path);
+            continue;
+        }
+
+        if (queue->capacity < queue->count + 1) {
+            int oldCapacity = queue->capacity;
+            queue->capacity = GROW_CAPACITY(oldCapacity);
+            queue->jobs = GROW_ARRAY(CompileJob, queue->jobs,
+                                     oldCapacity, queue->capacity,
+                                     MEM_COMPILER);
+        }
+
+        CompileJob *job = &queue->jobs[queue->count++];
+        memset(job, 0, sizeof(*job));
+        job->path = path;
+    }
+
+    closedir(dir);
+    // Sorted so reports are stable whatever the scheduling
+    if (queue->count > 0)
+        qsort(queue->jobs, queue->count, sizeof(CompileJob), compareJobs);
+
+    return true;
+}
+
+int compileAll(const char *directory, int threadCount) {
+    JobQueue queue = {NULL, 0, 0, 0};
+    if (!listSources(directory, &queue)) {
+        for (int i = 0; i < queue.count; i++) free(queue.jobs[i].path);
+        FREE_ARRAY(CompileJob, queue.jobs, queue.capacity, MEM_COMPILER);
+        return 74; // I/0 error
+    }
+
+    CompileJob *jobs = queue.jobs;
+    int count = queue.count;
+    if (threadCount > count) threadCount = count;
+    if (threadCount < 1) threadCount = 1;
+
+    pthread_t *threads = malloc(sizeof(pthread_t) * threadCount);
+    bool *started = malloc(sizeof(bool) * threadCount);
+
+    long long start = now();
+    for (int i = 0; i < threadCount; i++)
+        started[i] = pthread_create(&threads[i], NULL, worker, &queue) == 0;
+    for (int i = 0; i < threadCount; i++) {
+        // Workers share the queue, so one run here drains what a
+        // thread that could not start would have taken
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+        else {
+            worker(&queue);
+        }
+    }
+    long long elapsed = now() - start;
+
+    int failures = 0;
+    long long sourceBytes = 0;
+    for (int i = 0; i < count; i++) {
+        CompileJob *job = &jobs[i];
+        sourceBytes += job->sourceBytes;
+        if (!job->compiled) failures++;
+
+        printf("%-40s %s %8ld B -> %6d B %10.3f ms\n", job->path,
+               job->compiled ? "ok  " : "FAIL", job->sourceBytes,
+               job->codeBytes, job->nanoseconds / 1e6);
+        free(job->path);
+    }
+
+    double seconds = elapsed / 1e9;
+    printf("%d files (%d failed), %lld bytes on %d threads in %.3f ms: "
+           "%.1f files/s, %.2f MB/s\n",
+           count, failures, sourceBytes, threadCount, seconds * 1e3,
+           count / seconds, sourceBytes / seconds / 1e6);
+
+    free(threads);
+    free(started);
+    FREE_ARRAY(CompileJob, jobs, queue.capacity, MEM_COMPILER);
+    return failures > 0 ? 65 : 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "common.h"
+
+// Compiles every .lox file in directory on a pool of threadCount
+// workers and reports per-file and aggregate throughput. Returns the
+// process exit status.
+int compileAll(const char *directory, int threadCount);
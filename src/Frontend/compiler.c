@@ -1,20 +1,34 @@
 #include "compiler.h"
 #include "Chunk/chunk.h"
+#include "Chunk/verify.h"
+#include "Core/memory.h"
+#include "Core/metrics.h"
+#include "Core/number.h"
+#include "Core/object.h"
+#include "Core/output.h"
+#include "Core/utf8.h"
 #include "Core/value.h"
 #include "VM/vm.h"
 #include "lexer.h"
+#include "Frontend/ir.h"
 #include "Frontend/lexer.h"
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #ifdef DEBUG_PRINT_CODE
 #include "Debug/debug.h"
 #endif
 
+// Tokens are consumed by index from a buffer lexed up front
 typedef struct {
-    Token current;
-    Token previous;
+    TokenBuffer tokens;
+    int current;
+    int previous;
+    int currentLine;
+    int previousLine;
     bool hadError;
     bool panicMode;
 } Parser;
@@ -33,16 +47,42 @@ typedef enum {
   PREC_PRIMARY
 } Precedence;
 
-typedef void (*ParseFn)();
+// Parse functions return the IR node of what they parsed, or -1
+typedef int (*PrefixFn)();
+typedef int (*InfixFn)(int left);
 
 typedef struct {
-    ParseFn prefix;
-    ParseFn infix;
+    PrefixFn prefix;
+    InfixFn infix;
     Precedence precedence;
 } ParseRule;
 
-Parser parser;
-Chunk *compilingChunk;
+// Per thread so independent sources can compile concurrently
+_Thread_local Parser parser;
+_Thread_local Chunk *compilingChunk;
+_Thread_local IrGraph *compilingGraph;
+static _Thread_local SourceBuffer *sourceBuffer = NULL;
+// Input columns bare identifiers refer to, only set by compileColumns()
+static _Thread_local const char **columnNames = NULL;
+static _Thread_local int columnCount = 0;
+
+static bool irDumpEnabled = false;
+static int lexThreads = 1;
+
+void setIrDump(bool enabled) {
+    irDumpEnabled = enabled;
+}
+
+void setLexThreads(int threads) {
+    lexThreads = threads;
+}
+
+SourceBuffer *setSourceBuffer(SourceBuffer *source) {
+    SourceBuffer *previous = sourceBuffer;
+    sourceBuffer = source;
+
+    return previous;
+}
 
 static Chunk *currentChunk() {
     return compilingChunk;
@@ -51,6 +91,7 @@ static Chunk *currentChunk() {
 static void errorAt(Token *token, const char *message) {
     if (parser.panicMode) return;
     parser.panicMode = true; // But Don't Panic
+    flushOutput();
 
     fprintf(stderr, "[line %d] Error", token->line);
 
@@ -66,28 +107,45 @@ static void errorAt(Token *token, const char *message) {
     parser.hadError = true;
 }
 
+static TokenType currentType() {
+    return (TokenType)parser.tokens.types[parser.current];
+}
+
+static TokenType previousType() {
+    return (TokenType)parser.tokens.types[parser.previous];
+}
+
+static Token previousToken() {
+    return tokenAt(&parser.tokens, parser.previous, parser.previousLine);
+}
+
 static void error(const char *message) {
-    errorAt(&parser.previous, message);
+    Token token = previousToken();
+    errorAt(&token, message);
 }
 
 static void errorAtCurrent(const char *message) {
-    errorAt(&parser.current, message);
+    Token token = tokenAt(&parser.tokens, parser.current, parser.currentLine);
+    errorAt(&token, message);
 }
 
 static void advance() {
     parser.previous = parser.current;
+    parser.previousLine = parser.currentLine;
 
-    while (true) {
-        parser.current = scanToken(); 
+    // The buffer ends in TOKEN_EOF, which is never stepped past
+    while (parser.current < parser.tokens.count - 1) {
+        parser.current++;
+        parser.currentLine += parser.tokens.lineDeltas[parser.current];
         // skip if no error
-        if (parser.current.type != TOKEN_ERROR) break;
+        if (currentType() != TOKEN_ERROR) break;
 
-        errorAtCurrent(parser.current.start);
+        errorAtCurrent(tokenAt(&parser.tokens, parser.current, 0).start);
     }
 }
 
 static void consume(TokenType type, const char *message) {
-    if (parser.current.type == type) {
+    if (currentType() == type) {
         advance();
 
         return;
@@ -97,36 +155,57 @@ static void consume(TokenType type, const char *message) {
 }
 
 static void emitByte(uint8_t byte) {
-    writeChunk(currentChunk(), byte, parser.previous.line);
-}
-
-static void emitBytes(uint8_t byte1, uint8_t byte2) {
-    emitByte(byte1);
-    emitByte(byte2);
+    writeChunk(currentChunk(), byte, parser.previousLine);
 }
 
 static void emitReturn() {
     emitByte(OP_RETURN);
 }
 
-static uint8_t makeConstant(Value value) {
-    int constant = addConstant(currentChunk(), value);
-    if (constant > UINT8_MAX) {
-        error("Too many constant in one chunk.");
-
-        return 0;
-    }
+static int makeNode(uint8_t op, int left, int right) {
+    return addIrNode(compilingGraph, op, left, right,
+                     MAKE_NIL_VAL, parser.previousLine);
+}
 
-    return (uint8_t)constant; // Index
+static int makeConstant(Value value) {
+    return addIrNode(compilingGraph, OP_CONSTANT, -1, -1,
+                     value, parser.previousLine);
 }
 
-static void emitConstant(Value value) {
-    emitBytes(OP_CONSTANT, makeConstant(value));
+static int countInstructions(Chunk *chunk) {
+    int count = 0;
+    for (int offset = 0; offset < chunk->count;
+         offset += instructionSize(chunk, offset))
+    {
+        count++;
+    }
+
+    return count;
 }
 
 static void endCompiler() {
+    IrGraph *graph = compilingGraph;
+    // Before any pass every node lowers to one instruction
+    int unoptimized = graph->count + 1;
+
+    optimizeIr(graph);
+    inferTypes(graph);
+    if (!lowerIr(graph, currentChunk()))
+        error("Too many constant in one chunk.");
     emitReturn();
 
+    // Lowering gets no more trust than bytecode read from a file
+    if (!parser.hadError) {
+        const char *problem = verifyChunk(currentChunk());
+        if (problem != NULL) error(problem);
+    }
+
+    if (irDumpEnabled && !parser.hadError) {
+        dumpIr(graph);
+        printOutput("instructions: %d unoptimized, %d optimized\n",
+                    unoptimized, countInstructions(currentChunk()));
+    }
+
 #ifdef DEBUG_PRINT_CODE
     if (!parser.hadError) {
         disassembleChunk(currentChunk(), "code");
@@ -134,71 +213,196 @@ static void endCompiler() {
 #endif
 }
 
-static void expression();
+static int expression();
 static ParseRule *getRule(TokenType type);
-static void parsePrecedence(Precedence precedence);
+static int parsePrecedence(Precedence precedence);
 
-static void binary() {
-    TokenType operatorType = parser.previous.type;
+static int binary(int left) {
+    TokenType operatorType = previousType();
     ParseRule* rule = getRule(operatorType);
-    parsePrecedence((Precedence)(rule->precedence + 1));
+    int right = parsePrecedence((Precedence)(rule->precedence + 1));
 
     switch (operatorType) {
-        case TOKEN_BANG_EQUAL:    emitBytes(OP_EQUAL, OP_NOT); break;
-        case TOKEN_EQUAL_EQUAL:   emitByte(OP_EQUAL); break;
-        case TOKEN_GREATER:       emitByte(OP_GREATER); break;
-        case TOKEN_GREATER_EQUAL: emitBytes(OP_LESS, OP_NOT); break;
-        case TOKEN_LESS:          emitByte(OP_LESS); break;
-        case TOKEN_LESS_EQUAL:    emitBytes(OP_GREATER, OP_NOT); break;
-        case TOKEN_PLUS: emitByte(OP_ADD); break;
-        case TOKEN_MINUS: emitByte(OP_SUBTRACT); break;
-        case TOKEN_STAR: emitByte(OP_MULTIPLY); break;
-        case TOKEN_SLASH: emitByte(OP_DIVIDE); break;
-        default: return; // Unreachable
+        case TOKEN_BANG_EQUAL:
+            return makeNode(OP_NOT, makeNode(OP_EQUAL, left, right), -1);
+        case TOKEN_EQUAL_EQUAL:   return makeNode(OP_EQUAL, left, right);
+        case TOKEN_GREATER:       return makeNode(OP_GREATER, left, right);
+        case TOKEN_GREATER_EQUAL:
+            return makeNode(OP_NOT, makeNode(OP_LESS, left, right), -1);
+        case TOKEN_LESS:          return makeNode(OP_LESS, left, right);
+        case TOKEN_LESS_EQUAL:
+            return makeNode(OP_NOT, makeNode(OP_GREATER, left, right), -1);
+        case TOKEN_PLUS: return makeNode(OP_ADD, left, right);
+        case TOKEN_MINUS: return makeNode(OP_SUBTRACT, left, right);
+        case TOKEN_STAR: return makeNode(OP_MULTIPLY, left, right);
+        case TOKEN_SLASH: return makeNode(OP_DIVIDE, left, right);
+        default: return -1; // Unreachable
     }
 }
 
-static void literal() {
-    switch (parser.previous.type) {
-        case TOKEN_FALSE: emitByte(OP_FALSE); break;
-        case TOKEN_NIL: emitByte(OP_NIL); break;
-        case TOKEN_TRUE: emitByte(OP_TRUE); break;
-        default: return; // Unreachable
+static int literal() {
+    switch (previousType()) {
+        case TOKEN_FALSE: return makeNode(OP_FALSE, -1, -1);
+        case TOKEN_NIL: return makeNode(OP_NIL, -1, -1);
+        case TOKEN_TRUE: return makeNode(OP_TRUE, -1, -1);
+        default: return -1; // Unreachable
     }
 }
 
-static void expression() {
-    parsePrecedence(PREC_ASSIGNMENT);
+static int expression() {
+    return parsePrecedence(PREC_ASSIGNMENT);
 }
 
-static void grouping() {
-    expression();
+static int grouping() {
+    int inner = expression();
     consume(TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
+
+    return inner;
+}
+
+static int number() {
+    Token token = previousToken();
+    const char *start = token.start;
+    int length = token.length;
+
+    // Integral literals stay exact unless they overflow an int64
+    int64_t integer;
+    if (parseInteger(start, length, &integer))
+        return makeConstant(MAKE_INT_VAL(integer));
+
+    return makeConstant(MAKE_NUMBER_VAL(parseDouble(start, length)));
+}
+
+static int string() {
+    Token token = previousToken();
+    // String without quotes
+    const char *chars = token.start + 1;
+    int length = token.length - 2;
+
+    // Validating counts the code points, so the string takes the count
+    // rather than scanning the text again
+    int codePoints;
+    if (!validateUtf8(chars, length, &codePoints)) {
+        error("Invalid UTF-8 in string.");
+        return -1;
+    }
+
+    // A view is only safe if the text is the buffer's, not a copy
+    if (sourceBuffer != NULL && chars >= sourceBuffer->chars &&
+        chars + length <= sourceBuffer->chars + sourceBuffer->length)
+        return makeConstant(MAKE_OBJ_VAL(
+                viewString(sourceBuffer, chars, length, codePoints)));
+
+    return makeConstant(MAKE_OBJ_VAL(
+            copyCountedString(chars, length, codePoints)));
+}
+
+static int array() {
+    // Elements are number literals, so the array is a constant
+    double *values = NULL;
+    int count = 0;
+    int capacity = 0;
+
+    while (currentType() != TOKEN_RIGHT_BRACKET && !parser.hadError) {
+        if (count > 0) consume(TOKEN_COMMA, "Expect ',' between elements.");
+
+        bool negative = currentType() == TOKEN_MINUS;
+        if (negative) advance();
+        consume(TOKEN_NUMBER, "Expect number literal in array.");
+        if (parser.hadError) break;
+
+        if (capacity < count + 1) {
+            int oldCapacity = capacity;
+            capacity = GROW_CAPACITY(oldCapacity);
+            values = GROW_ARRAY(double, values, oldCapacity, capacity,
+                                MEM_COMPILER);
+        }
+
+        Token token = previousToken();
+        double value = parseDouble(token.start, token.length);
+        values[count++] = negative ? -value : value;
+    }
+    consume(TOKEN_RIGHT_BRACKET, "Expect ']' after array elements.");
+
+    int node = makeConstant(MAKE_OBJ_VAL(copyArray(values, count)));
+    FREE_ARRAY(double, values, capacity, MEM_COMPILER);
+
+    return node;
+}
+
+typedef struct {
+    const char *name;
+    uint8_t op;
+    int arity; // At most two, one per IR operand
+} Builtin;
+
+static const Builtin builtins[] = {
+    {"sum", OP_SUM, 1},
+    {"dot", OP_DOT, 2},
+    {"min", OP_MIN, 1},
+    {"max", OP_MAX, 1},
+    {"range", OP_RANGE, 1},
+    {"len", OP_LENGTH, 1},
+};
+
+static int column(Token name) {
+    for (int i = 0; i < columnCount; i++) {
+        if ((int)strlen(columnNames[i]) == name.length &&
+            memcmp(columnNames[i], name.start, name.length) == 0)
+            return addIrNode(compilingGraph, OP_COLUMN, -1, -1,
+                             MAKE_INT_VAL(i), parser.previousLine);
+    }
+
+    error("Unknown column.");
+    return -1;
 }
 
-static void number() {
-    double value = strtod(parser.previous.start, NULL);
-    emitConstant(MAKE_NUMBER_VAL(value));
+static int call() {
+    Token name = previousToken();
+    if (columnCount > 0 && currentType() != TOKEN_LEFT_PAREN)
+        return column(name);
+
+    const Builtin *builtin = NULL;
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        if ((int)strlen(builtins[i].name) == name.length &&
+            memcmp(builtins[i].name, name.start, name.length) == 0)
+            builtin = &builtins[i];
+    }
+
+    if (builtin == NULL) {
+        error("Unknown function.");
+        return -1;
+    }
+
+    consume(TOKEN_LEFT_PAREN, "Expect '(' after function name.");
+    int arguments[2] = {-1, -1};
+    for (int i = 0; i < builtin->arity; i++) {
+        if (i > 0) consume(TOKEN_COMMA, "Expect ',' between arguments.");
+        arguments[i] = expression();
+    }
+    consume(TOKEN_RIGHT_PAREN, "Expect ')' after arguments.");
+
+    return makeNode(builtin->op, arguments[0], arguments[1]);
 }
 
-static void string() {
-    emitConstant(MAKE_OBJ_VAL(
-            // String without quotes
-            copyString(parser.previous.start + 1,
-                       parser.previous.length - 2)));
+static int subscript(int sequence) {
+    int index = expression();
+    consume(TOKEN_RIGHT_BRACKET, "Expect ']' after index.");
+
+    return makeNode(OP_INDEX, sequence, index);
 }
 
-static void unary() {
-    TokenType operatorType = parser.previous.type;
+static int unary() {
+    TokenType operatorType = previousType();
 
     // Compile the operand.
-    parsePrecedence(PREC_UNARY);
+    int operand = parsePrecedence(PREC_UNARY);
 
-    // Emit the operator instruction
+    // Build the operator node
     switch (operatorType) {
-        case TOKEN_BANG: emitByte(OP_NOT); break;
-        case TOKEN_MINUS: emitByte(OP_NEGATE); break;
-        default: return; // Unreachable
+        case TOKEN_BANG: return makeNode(OP_NOT, operand, -1);
+        case TOKEN_MINUS: return makeNode(OP_NEGATE, operand, -1);
+        default: return -1; // Unreachable
     }
 }
 
@@ -207,6 +411,8 @@ ParseRule rules[] = {
   [TOKEN_RIGHT_PAREN]   = {NULL,     NULL,   PREC_NONE},
   [TOKEN_LEFT_BRACE]    = {NULL,     NULL,   PREC_NONE}, 
   [TOKEN_RIGHT_BRACE]   = {NULL,     NULL,   PREC_NONE},
+  [TOKEN_LEFT_BRACKET]  = {array,    subscript, PREC_CALL},
+  [TOKEN_RIGHT_BRACKET] = {NULL,     NULL,   PREC_NONE},
   [TOKEN_COMMA]         = {NULL,     NULL,   PREC_NONE},
   [TOKEN_DOT]           = {NULL,     NULL,   PREC_NONE},
   [TOKEN_MINUS]         = {unary,    binary, PREC_TERM},
@@ -222,7 +428,7 @@ ParseRule rules[] = {
   [TOKEN_GREATER_EQUAL] = {NULL,     binary, PREC_COMPARISON},
   [TOKEN_LESS]          = {NULL,     binary, PREC_COMPARISON},
   [TOKEN_LESS_EQUAL]    = {NULL,     binary, PREC_COMPARISON},
-  [TOKEN_IDENTIFIER]    = {NULL,     NULL,   PREC_NONE},
+  [TOKEN_IDENTIFIER]    = {call,     NULL,   PREC_NONE},
   [TOKEN_STRING]        = {string,   NULL,   PREC_NONE},
   [TOKEN_NUMBER]        = {number,   NULL,   PREC_NONE},
   [TOKEN_AND]           = {NULL,     NULL,   PREC_NONE},
@@ -245,40 +451,81 @@ ParseRule rules[] = {
   [TOKEN_EOF]           = {NULL,     NULL,   PREC_NONE},
 };
 
-static void parsePrecedence(Precedence precedence) {
+static int parsePrecedence(Precedence precedence) {
     advance();
 
-    ParseFn prefixRule = getRule(parser.previous.type)->prefix;
+    PrefixFn prefixRule = getRule(previousType())->prefix;
     if (prefixRule == NULL) {
         error("Expect expression.");
 
-        return;
+        return -1;
     }
 
-    prefixRule();
+    int node = prefixRule();
 
-    while (precedence <= getRule(parser.current.type)->precedence) {
+    while (precedence <= getRule(currentType())->precedence) {
         advance();
-        ParseFn infixRule = getRule(parser.previous.type)->infix;
-        infixRule();
+        InfixFn infixRule = getRule(previousType())->infix;
+        node = infixRule(node);
     }
+
+    return node;
 }
 
 static ParseRule *getRule(TokenType type) {
     return &rules[type];
 }
 
+static uint64_t nanoseconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000u + time.tv_nsec;
+}
+
 bool compile(const char *source, Chunk *chunk) {
-    initLexer(source);
+    // The clock is only read for someone watching
+    uint64_t start = metrics != NULL ? nanoseconds() : 0;
+
+    initTokenBuffer(&parser.tokens);
+    lexSource(source, &parser.tokens, lexThreads);
+    parser.current = -1;
+    parser.currentLine = 0;
     compilingChunk = chunk;
 
+    IrGraph graph;
+    initIrGraph(&graph);
+    compilingGraph = &graph;
+
     parser.hadError = false;
     parser.panicMode = false;
 
     advance();
-    expression();
+    graph.root = expression();
     consume(TOKEN_EOF, "Expect end of expression");
 
-    endCompiler();
+    if (!parser.hadError)
+        endCompiler();
+
+    freeIrGraph(&graph);
+    freeTokenBuffer(&parser.tokens);
+
+    if (metrics != NULL) {
+        COUNT_METRIC(compiles, 1);
+        if (parser.hadError) COUNT_METRIC(compileErrors, 1);
+        COUNT_METRIC(compileNanoseconds, nanoseconds() - start);
+    }
     return !parser.hadError; 
 }
+
+bool compileColumns(const char *source, const char **names, int count,
+                    Chunk *chunk)
+{
+    columnNames = names;
+    columnCount = count;
+    bool compiled = compile(source, chunk);
+    columnNames = NULL;
+    columnCount = 0;
+
+    return compiled;
+}
@@ -6,3 +6,14 @@
 #include "lexer.h"
 
 bool compile(const char *source, Chunk *chunk);
+// Prints the optimized IR and instruction counts for each compile
+void setIrDump(bool enabled);
+// Threads a large source may be lexed on, 1 to stay on the caller's
+void setLexThreads(int threads);
+// Lets string literals this thread compiles from source's text view it
+// instead of copying; returns the previous buffer, NULL for none
+SourceBuffer *setSourceBuffer(SourceBuffer *source);
+// Like compile, but bare identifiers name input columns, the first
+// count of names, for batch evaluation
+bool compileColumns(const char *source, const char **names, int count,
+                    Chunk *chunk);
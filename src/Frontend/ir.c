@@ -0,0 +1,607 @@
+#include "ir.h"
+#include "Chunk/chunk.h"
+#include "Core/memory.h"
+#include "Core/object.h"
+#include "Core/output.h"
+#include "Core/value.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define UINT8_COUNT (UINT8_MAX + 1)
+
+void initIrGraph(IrGraph *graph) {
+    graph->count = 0;
+    graph->capacity = 0;
+    graph->nodes = NULL;
+    graph->root = -1;
+    graph->checkedOps = 0;
+    graph->uncheckedOps = 0;
+}
+
+void freeIrGraph(IrGraph *graph) {
+    FREE_ARRAY(IrNode, graph->nodes, graph->capacity, MEM_COMPILER);
+    initIrGraph(graph);
+}
+
+static IrType typeOf(IrGraph *graph, int index) {
+    return index < 0 ? IR_UNKNOWN : graph->nodes[index].type;
+}
+
+static bool isNumericType(IrType type) {
+    return type == IR_INT || type == IR_DOUBLE || type == IR_NUMBER;
+}
+
+// Operands that raise stop evaluation before the operator runs, so an
+// arithmetic result is a number whatever its operands
+static IrType arithmeticType(IrType left, IrType right) {
+    return left == IR_DOUBLE && right == IR_DOUBLE ? IR_DOUBLE : IR_NUMBER;
+}
+
+// Array + and * broadcast numbers; anything else is unknown or raises
+static IrType elementwiseType(IrType left, IrType right) {
+    if ((left == IR_ARRAY && (right == IR_ARRAY || isNumericType(right))) ||
+        (right == IR_ARRAY && isNumericType(left)))
+        return IR_ARRAY;
+
+    return IR_UNKNOWN;
+}
+
+static IrType inferType(IrGraph *graph, uint8_t op, int left, int right,
+                        Value constant)
+{
+    IrType leftType = typeOf(graph, left);
+    IrType rightType = typeOf(graph, right);
+
+    switch (op) {
+        case OP_CONSTANT:
+            if (IS_INT(constant)) return IR_INT;
+            if (IS_DOUBLE(constant)) return IR_DOUBLE;
+            if (IS_STRING(constant)) return IR_STRING;
+            if (IS_ARRAY(constant)) return IR_ARRAY;
+            return IR_UNKNOWN;
+        case OP_NIL: return IR_NIL;
+        case OP_TRUE:
+        case OP_FALSE:
+        case OP_EQUAL:
+        case OP_LESS:
+        case OP_GREATER:
+        case OP_NOT:
+            return IR_BOOL;
+        case OP_ADD:
+            if (isNumericType(leftType) && isNumericType(rightType))
+                return arithmeticType(leftType, rightType);
+            if (leftType == IR_STRING && rightType == IR_STRING)
+                return IR_STRING;
+            return elementwiseType(leftType, rightType);
+        case OP_MULTIPLY:
+            if (isNumericType(leftType) && isNumericType(rightType))
+                return arithmeticType(leftType, rightType);
+            return elementwiseType(leftType, rightType);
+        case OP_SUBTRACT:
+            return arithmeticType(leftType, rightType);
+        case OP_DIVIDE: return IR_DOUBLE;
+        // Negating int 0 yields a double -0
+        case OP_NEGATE:
+            return leftType == IR_DOUBLE ? IR_DOUBLE : IR_NUMBER;
+        case OP_SUM:
+        case OP_DOT:
+        case OP_MIN:
+        case OP_MAX:
+            return IR_DOUBLE;
+        case OP_RANGE: return IR_ARRAY;
+        case OP_LENGTH: return IR_INT;
+        case OP_INDEX:
+            if (leftType == IR_STRING) return IR_STRING;
+            if (leftType == IR_ARRAY) return IR_DOUBLE;
+            return IR_UNKNOWN;
+        default: return IR_UNKNOWN;
+    }
+}
+
+int addIrNode(IrGraph *graph, uint8_t op, int left, int right,
+              Value constant, int line)
+{
+    if (graph->capacity < graph->count + 1) {
+        int oldCapacity = graph->capacity;
+        graph->capacity = GROW_CAPACITY(oldCapacity);
+        graph->nodes = GROW_ARRAY(IrNode, graph->nodes,
+                                  oldCapacity, graph->capacity,
+                                  MEM_COMPILER);
+    }
+
+    IrNode *node = &graph->nodes[graph->count];
+    node->op = op;
+    node->left = left;
+    node->right = right;
+    node->constant = constant;
+    node->line = line;
+    node->type = inferType(graph, op, left, right, constant);
+
+    return graph->count++;
+}
+
+static bool isLeaf(IrNode *node) {
+    return node->left < 0;
+}
+
+// Nodes are added children first, so every operand has a lower index
+// than its users. The passes below rely on that to walk the graph with
+// loops over indices instead of recursion, which a long left-nested
+// chain would overflow the C stack with.
+
+// Marks the nodes the root reaches into reachable; a sweep down from
+// the top sees every user before its operands
+static void markReachable(IrGraph *graph, bool *reachable) {
+    memset(reachable, 0, sizeof(bool) * graph->count);
+    reachable[graph->root] = true;
+
+    for (int index = graph->count - 1; index >= 0; index--) {
+        if (!reachable[index]) continue;
+
+        IrNode *node = &graph->nodes[index];
+        if (node->left >= 0) reachable[node->left] = true;
+        if (node->right >= 0) reachable[node->right] = true;
+    }
+}
+
+static bool isNumeric(IrGraph *graph, int index) {
+    return isNumericType(typeOf(graph, index));
+}
+
+static bool isBoolean(IrGraph *graph, int index) {
+    return typeOf(graph, index) == IR_BOOL;
+}
+
+// Integral identities only, a double one or zero could turn an exact
+// int into a rounded double
+static bool isIntConstant(IrGraph *graph, int index, int64_t value) {
+    IrNode *node = &graph->nodes[index];
+
+    return node->op == OP_CONSTANT && IS_INT(node->constant) &&
+           AS_INT(node->constant) == value;
+}
+
+// Simplifies the node at index, whose operands already are, returns
+// the node replacing it
+static int simplifyNode(IrGraph *graph, int index) {
+    IrNode *node = &graph->nodes[index];
+
+    switch (node->op) {
+        case OP_MULTIPLY:
+            // x * 1 and 1 * x
+            if (isIntConstant(graph, node->right, 1) &&
+                isNumeric(graph, node->left))
+                return node->left;
+            if (isIntConstant(graph, node->left, 1) &&
+                isNumeric(graph, node->right))
+                return node->right;
+            break;
+        case OP_SUBTRACT:
+            // x - 0, which also keeps -0 intact
+            if (isIntConstant(graph, node->right, 0) &&
+                isNumeric(graph, node->left))
+                return node->left;
+            break;
+        case OP_NEGATE: {
+            // -(-x), unless x is an int that negating turns into a
+            // double: 0 becomes -0 and INT64_MIN has no int negation
+            IrNode *operand = &graph->nodes[node->left];
+            if (operand->op != OP_NEGATE) break;
+
+            IrNode *x = &graph->nodes[operand->left];
+            if (typeOf(graph, operand->left) == IR_DOUBLE ||
+                (x->op == OP_CONSTANT && IS_INT(x->constant) &&
+                 AS_INT(x->constant) != 0 &&
+                 AS_INT(x->constant) != INT64_MIN))
+                return operand->left;
+            break;
+        }
+        case OP_NOT: {
+            // !!x is x when x is already a boolean, so a third ! in
+            // boolean context collapses !!!x to !x
+            IrNode *operand = &graph->nodes[node->left];
+            if (operand->op == OP_NOT && isBoolean(graph, operand->left))
+                return operand->left;
+            break;
+        }
+    }
+
+    return index;
+}
+
+// Simplifies every node the root reaches, operands first, and returns
+// the node replacing the root
+static int simplify(IrGraph *graph) {
+    bool *reachable = ALLOCATE(bool, graph->count, MEM_COMPILER);
+    int *replacement = ALLOCATE(int, graph->count, MEM_COMPILER);
+    markReachable(graph, reachable);
+
+    for (int index = 0; index < graph->count; index++) {
+        if (!reachable[index]) continue;
+
+        IrNode *node = &graph->nodes[index];
+        if (node->left >= 0) node->left = replacement[node->left];
+        if (node->right >= 0) node->right = replacement[node->right];
+        replacement[index] = simplifyNode(graph, index);
+    }
+
+    int root = replacement[graph->root];
+    FREE_ARRAY(bool, reachable, graph->count, MEM_COMPILER);
+    FREE_ARRAY(int, replacement, graph->count, MEM_COMPILER);
+    return root;
+}
+
+// Identity, not Lox equality: 1 and 1.0 or 0.0 and -0.0 stay distinct
+static bool sameConstant(Value a, Value b) {
+    if (a.type != b.type) return false;
+    if (IS_DOUBLE(a))
+        return memcmp(&a.as.number, &b.as.number, sizeof(double)) == 0;
+
+    return valuesEqual(a, b);
+}
+
+static uint32_t hashBytes(uint32_t hash, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619; // FNV-1a
+    }
+
+    return hash;
+}
+
+static uint32_t hashNode(IrNode *node) {
+    uint32_t hash = 2166136261u;
+    hash = hashBytes(hash, &node->op, sizeof(node->op));
+    hash = hashBytes(hash, &node->left, sizeof(node->left));
+    hash = hashBytes(hash, &node->right, sizeof(node->right));
+
+    if (node->op == OP_CONSTANT || node->op == OP_COLUMN) {
+        Value constant = node->constant;
+        if (IS_STRING(constant)) {
+            ObjString *string = AS_STRING(constant);
+            hash = hashBytes(hash, string->chars, string->length);
+        }
+        else {
+            hash = hashBytes(hash, &constant.as, sizeof(constant.as));
+        }
+    }
+
+    return hash;
+}
+
+static bool sameNode(IrNode *a, IrNode *b) {
+    if (a->op != b->op || a->left != b->left || a->right != b->right)
+        return false;
+
+    if (a->op != OP_CONSTANT && a->op != OP_COLUMN) return true;
+
+    return sameConstant(a->constant, b->constant);
+}
+
+typedef struct {
+    int *entries; // Node indices, -1 when empty
+    int capacity; // Power of two
+} NodeTable;
+
+// Value numbering: operands are already canonical when a node is
+// visited, so structurally equal nodes compute the same value
+static void canonicalize(IrGraph *graph, NodeTable *table, int *canonical,
+                         int index)
+{
+    IrNode *node = &graph->nodes[index];
+    if (node->left >= 0) node->left = canonical[node->left];
+    if (node->right >= 0) node->right = canonical[node->right];
+
+    uint32_t slot = hashNode(node) & (table->capacity - 1);
+    for (;;) {
+        int entry = table->entries[slot];
+        if (entry < 0) {
+            table->entries[slot] = index;
+            canonical[index] = index;
+            break;
+        }
+        if (sameNode(&graph->nodes[entry], node)) {
+            canonical[index] = entry;
+            break;
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+}
+
+void optimizeIr(IrGraph *graph) {
+    if (graph->root < 0) return;
+
+    graph->root = simplify(graph);
+
+    NodeTable table;
+    table.capacity = 8;
+    while (table.capacity < graph->count * 2) table.capacity *= 2;
+    table.entries = ALLOCATE(int, table.capacity, MEM_COMPILER);
+    memset(table.entries, -1, sizeof(int) * table.capacity);
+
+    bool *reachable = ALLOCATE(bool, graph->count, MEM_COMPILER);
+    int *canonical = ALLOCATE(int, graph->count, MEM_COMPILER);
+    markReachable(graph, reachable);
+
+    for (int index = 0; index < graph->count; index++) {
+        if (reachable[index]) canonicalize(graph, &table, canonical, index);
+    }
+    graph->root = canonical[graph->root];
+
+    FREE_ARRAY(bool, reachable, graph->count, MEM_COMPILER);
+    FREE_ARRAY(int, canonical, graph->count, MEM_COMPILER);
+    FREE_ARRAY(int, table.entries, table.capacity, MEM_COMPILER);
+}
+
+// Unchecked variant of a type-checking opcode for the given operand
+// types, or the opcode itself when the checks must stay
+static uint8_t uncheckedOp(uint8_t op, IrType left, IrType right) {
+    bool numbers = isNumericType(left) && isNumericType(right);
+
+    switch (op) {
+        case OP_ADD:
+            if (numbers) return OP_ADD_NN;
+            if (left == IR_STRING && right == IR_STRING) return OP_CONCAT;
+            return op;
+        case OP_SUBTRACT: return numbers ? OP_SUBTRACT_NN : op;
+        case OP_MULTIPLY: return numbers ? OP_MULTIPLY_NN : op;
+        case OP_DIVIDE: return numbers ? OP_DIVIDE_NN : op;
+        case OP_LESS: return numbers ? OP_LESS_NN : op;
+        case OP_GREATER: return numbers ? OP_GREATER_NN : op;
+        case OP_NEGATE: return isNumericType(left) ? OP_NEGATE_N : op;
+        default: return op;
+    }
+}
+
+static bool checksTypes(uint8_t op) {
+    switch (op) {
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_LESS:
+        case OP_GREATER:
+        case OP_NEGATE:
+            return true;
+        default: return false;
+    }
+}
+
+static void specialize(IrGraph *graph, int index) {
+    IrNode *node = &graph->nodes[index];
+    if (!checksTypes(node->op)) return;
+
+    node->op = uncheckedOp(node->op, typeOf(graph, node->left),
+                           typeOf(graph, node->right));
+    if (checksTypes(node->op)) {
+        graph->checkedOps++;
+    }
+    else {
+        graph->uncheckedOps++;
+    }
+}
+
+void inferTypes(IrGraph *graph) {
+    if (graph->root < 0) return;
+
+    bool *reachable = ALLOCATE(bool, graph->count, MEM_COMPILER);
+    markReachable(graph, reachable);
+
+    graph->checkedOps = 0;
+    graph->uncheckedOps = 0;
+    for (int index = 0; index < graph->count; index++) {
+        if (reachable[index]) specialize(graph, index);
+    }
+
+    FREE_ARRAY(bool, reachable, graph->count, MEM_COMPILER);
+}
+
+typedef struct {
+    IrGraph *graph;
+    Chunk *chunk;
+    int *uses; // Incoming edges from reachable nodes
+    int *slots; // Stack slot holding a shared result, -1 when none
+    int *constants; // Constant pool index per node, -1 when none
+    int temps; // Slots reserved for shared results
+    int nextTemp;
+    bool hadError;
+} Lowering;
+
+// Counts uses once per reachable node, so dead nodes stay at zero; the
+// root's one use is the return
+static void countUses(Lowering *lowering) {
+    IrGraph *graph = lowering->graph;
+    lowering->uses[graph->root] = 1;
+
+    for (int index = graph->count - 1; index >= 0; index--) {
+        if (lowering->uses[index] == 0) continue;
+
+        IrNode *node = &graph->nodes[index];
+        if (node->left >= 0) lowering->uses[node->left]++;
+        if (node->right >= 0) lowering->uses[node->right]++;
+    }
+}
+
+static bool isShared(Lowering *lowering, int index) {
+    return lowering->uses[index] > 1 &&
+           !isLeaf(&lowering->graph->nodes[index]);
+}
+
+// Emits the node once its operands are on the stack
+static void emitNode(Lowering *lowering, int index) {
+    IrNode *node = &lowering->graph->nodes[index];
+    Chunk *chunk = lowering->chunk;
+
+    writeChunk(chunk, node->op, node->line);
+    if (node->op == OP_CONSTANT) {
+        if (lowering->constants[index] < 0)
+            lowering->constants[index] = addConstant(chunk, node->constant);
+
+        if (lowering->constants[index] > UINT8_MAX) {
+            lowering->hadError = true;
+            writeChunk(chunk, 0, node->line);
+        }
+        else {
+            writeChunk(chunk, (uint8_t)lowering->constants[index],
+                       node->line);
+        }
+    }
+    else if (node->op == OP_COLUMN) {
+        writeChunk(chunk, (uint8_t)AS_INT(node->constant), node->line);
+    }
+
+    // Keep a copy for later uses; slots past the reservation recompute
+    if (isShared(lowering, index) && lowering->nextTemp < lowering->temps) {
+        int slot = lowering->nextTemp++;
+        lowering->slots[index] = slot;
+        writeChunk(chunk, OP_SET_LOCAL, node->line);
+        writeChunk(chunk, (uint8_t)slot, node->line);
+    }
+}
+
+// Post-order walk from the root with an explicit stack of pending
+// work: each entry is a node index shifted left, its low bit set once
+// the node's operands have been pushed
+static void lowerNode(Lowering *lowering, int root) {
+    IrGraph *graph = lowering->graph;
+    int capacity = 8;
+    int count = 0;
+    int *pending = ALLOCATE(int, capacity, MEM_COMPILER);
+    pending[count++] = root << 1;
+
+    while (count > 0) {
+        int entry = pending[--count];
+        int index = entry >> 1;
+        if (entry & 1) {
+            emitNode(lowering, index);
+            continue;
+        }
+
+        if (lowering->slots[index] >= 0) {
+            IrNode *node = &graph->nodes[index];
+            writeChunk(lowering->chunk, OP_GET_LOCAL, node->line);
+            writeChunk(lowering->chunk, (uint8_t)lowering->slots[index],
+                       node->line);
+            continue;
+        }
+
+        if (capacity < count + 3) {
+            int oldCapacity = capacity;
+            capacity = GROW_CAPACITY(oldCapacity);
+            pending = GROW_ARRAY(int, pending, oldCapacity, capacity,
+                                 MEM_COMPILER);
+        }
+
+        // Popped in reverse: left operand first, the node itself last
+        IrNode *node = &graph->nodes[index];
+        pending[count++] = (index << 1) | 1;
+        if (node->right >= 0) pending[count++] = node->right << 1;
+        if (node->left >= 0) pending[count++] = node->left << 1;
+    }
+
+    FREE_ARRAY(int, pending, capacity, MEM_COMPILER);
+}
+
+bool lowerIr(IrGraph *graph, Chunk *chunk) {
+    if (graph->root < 0) return true;
+
+    Lowering lowering;
+    lowering.graph = graph;
+    lowering.chunk = chunk;
+    lowering.uses = ALLOCATE(int, graph->count, MEM_COMPILER);
+    lowering.slots = ALLOCATE(int, graph->count, MEM_COMPILER);
+    lowering.constants = ALLOCATE(int, graph->count, MEM_COMPILER);
+    lowering.temps = 0;
+    lowering.nextTemp = 0;
+    lowering.hadError = false;
+    memset(lowering.uses, 0, sizeof(int) * graph->count);
+    memset(lowering.slots, -1, sizeof(int) * graph->count);
+    memset(lowering.constants, -1, sizeof(int) * graph->count);
+
+    countUses(&lowering);
+    for (int i = 0; i < graph->count; i++) {
+        if (isShared(&lowering, i) && lowering.temps < UINT8_COUNT)
+            lowering.temps++;
+    }
+
+    // Reserve the bottom stack slots for shared results
+    int line = graph->nodes[graph->root].line;
+    for (int i = 0; i < lowering.temps; i++)
+        writeChunk(chunk, OP_NIL, line);
+
+    lowerNode(&lowering, graph->root);
+
+    FREE_ARRAY(int, lowering.uses, graph->count, MEM_COMPILER);
+    FREE_ARRAY(int, lowering.slots, graph->count, MEM_COMPILER);
+    FREE_ARRAY(int, lowering.constants, graph->count, MEM_COMPILER);
+    return !lowering.hadError;
+}
+
+static const char *opName(uint8_t op) {
+    switch (op) {
+        case OP_CONSTANT: return "constant";
+        case OP_NIL: return "nil";
+        case OP_TRUE: return "true";
+        case OP_FALSE: return "false";
+        case OP_EQUAL: return "equal";
+        case OP_GREATER: return "greater";
+        case OP_LESS: return "less";
+        case OP_ADD: return "add";
+        case OP_SUBTRACT: return "subtract";
+        case OP_MULTIPLY: return "multiply";
+        case OP_DIVIDE: return "divide";
+        case OP_NOT: return "not";
+        case OP_NEGATE: return "negate";
+        case OP_SUM: return "sum";
+        case OP_DOT: return "dot";
+        case OP_MIN: return "min";
+        case OP_MAX: return "max";
+        case OP_RANGE: return "range";
+        case OP_LENGTH: return "len";
+        case OP_INDEX: return "index";
+        case OP_COLUMN: return "column";
+        case OP_ADD_NN: return "add.nn";
+        case OP_SUBTRACT_NN: return "sub.nn";
+        case OP_MULTIPLY_NN: return "mul.nn";
+        case OP_DIVIDE_NN: return "div.nn";
+        case OP_LESS_NN: return "less.nn";
+        case OP_GREATER_NN: return "great.nn";
+        case OP_NEGATE_N: return "neg.n";
+        case OP_CONCAT: return "concat";
+        default: return "?";
+    }
+}
+
+static void dumpNode(IrGraph *graph, int index) {
+    IrNode *node = &graph->nodes[index];
+    printOutput("  v%-4d = %-8s", index, opName(node->op));
+    if (node->op == OP_CONSTANT || node->op == OP_COLUMN) {
+        printOutput(" ");
+        printValue(node->constant);
+    }
+    if (node->left >= 0) printOutput(" v%d", node->left);
+    if (node->right >= 0) printOutput(" v%d", node->right);
+    printOutput("\n");
+}
+
+void dumpIr(IrGraph *graph) {
+    if (graph->root < 0) return;
+
+    bool *reachable = ALLOCATE(bool, graph->count, MEM_COMPILER);
+    markReachable(graph, reachable);
+
+    // Index order lists every operand before its users
+    printOutput("== ir ==\n");
+    for (int index = 0; index < graph->count; index++) {
+        if (reachable[index]) dumpNode(graph, index);
+    }
+    printOutput("  return v%d\n", graph->root);
+    // Straight-line code runs each instruction once, so these static
+    // counts are also the executed type-check counts
+    printOutput("type checks: %d kept, %d removed\n",
+                graph->checkedOps, graph->uncheckedOps);
+
+    FREE_ARRAY(bool, reachable, graph->count, MEM_COMPILER);
+}
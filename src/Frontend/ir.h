@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Chunk/chunk.h"
+#include "Core/value.h"
+#include "common.h"
+
+// What a node yields if it completes without a runtime error
+typedef enum {
+    IR_UNKNOWN,
+    IR_NIL,
+    IR_BOOL,
+    IR_INT, // Int representation
+    IR_DOUBLE, // Double representation
+    IR_NUMBER, // Either representation
+    IR_STRING,
+    IR_ARRAY,
+} IrType;
+
+// Expression DAG built by the parser. Every node lowers to the single
+// opcode in op; != and >= are expressed as OP_NOT over a comparison.
+typedef struct {
+    uint8_t op;
+    int left;  // Operand node indices, -1 when absent
+    int right;
+    Value constant; // For OP_CONSTANT; OP_COLUMN keeps its index here
+    int line;
+    IrType type; // Inferred bottom-up when the node is added
+} IrNode;
+
+typedef struct {
+    int count;
+    int capacity;
+    IrNode *nodes;
+    int root;
+    int checkedOps; // Reachable opcodes still checking operand types
+    int uncheckedOps; // Those whose checks inferTypes() removed
+} IrGraph;
+
+void initIrGraph(IrGraph *graph);
+void freeIrGraph(IrGraph *graph);
+int addIrNode(IrGraph *graph, uint8_t op, int left, int right,
+              Value constant, int line);
+// Algebraic simplification followed by common-subexpression
+// elimination; nodes left unreachable from the root are dead
+void optimizeIr(IrGraph *graph);
+// Rewrites operators whose operand types are proven into unchecked
+// variants (OP_ADD_NN, OP_CONCAT, ...)
+void inferTypes(IrGraph *graph);
+// Emits code for the root into chunk; shared subexpressions are kept
+// in reserved stack slots. Returns false on too many constants.
+bool lowerIr(IrGraph *graph, Chunk *chunk);
+void dumpIr(IrGraph *graph);
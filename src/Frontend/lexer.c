@@ -1,25 +1,43 @@
 #include "common.h"
 #include "lexer.h"
+#include "Core/memory.h"
 
 #include <ctype.h>
+#include <pthread.h>
 #include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 
+// Sources shorter than this are lexed on the calling thread
+#define LEX_PARALLEL_MIN (1 << 20)
+#define LEX_THREADS_MAX 64
+
 typedef struct {
     const char* start; // Start of new token
     const char* current; // Most recently cosumed lexeme
+    const char* end; // Source end, or where this thread's piece stops
     int line;
 } Lexer;
 
-Lexer lexer;
+_Thread_local Lexer lexer;
 
-void initLexer(const char *source) {
-    lexer.start = source;
-    lexer.current = source;
+// Error tokens point here; buffered ones store the index
+static const char *errorMessages[] = {
+    "Unterminated string.",
+    "Unexpected character.",
+};
+
+static void initRange(const char *start, const char *end) {
+    lexer.start = start;
+    lexer.current = start;
+    lexer.end = end;
     lexer.line = 0;
 }
 
+void initLexer(const char *source) {
+    initRange(source, source + strlen(source));
+}
+
 static bool isAlpha(char c) {
     return (
         (c >= 'a' && c <= 'z') ||
@@ -33,7 +51,7 @@ static bool isDigit(char c) {
 }
 
 static bool isAtEnd() {
-    return *lexer.current == '\0';
+    return lexer.current >= lexer.end;
 }
 
 static char advance() {
@@ -43,11 +61,14 @@ static char advance() {
 }
 
 static char peek() {
+    if (isAtEnd())
+        return '\0';
+
     return *lexer.current;
 }
 
 static char peekNext() {
-    if (isAtEnd()) 
+    if (lexer.current + 1 >= lexer.end)
         return '\0';
 
     return lexer.current[1];
@@ -190,7 +211,7 @@ static Token handleString() {
     }
 
     if (isAtEnd()) 
-        return errorToken("Unterminated string.");
+        return errorToken(errorMessages[0]);
 
     // The closing quote.
     advance();
@@ -217,6 +238,8 @@ Token scanToken() {
         case ')': return makeToken(TOKEN_RIGHT_PAREN);
         case '{': return makeToken(TOKEN_LEFT_BRACE);
         case '}': return makeToken(TOKEN_RIGHT_BRACE);
+        case '[': return makeToken(TOKEN_LEFT_BRACKET);
+        case ']': return makeToken(TOKEN_RIGHT_BRACKET);
         case ';': return makeToken(TOKEN_SEMICOLON);
         case ',': return makeToken(TOKEN_COMMA);
         case '.': return makeToken(TOKEN_DOT);
@@ -241,5 +264,207 @@ Token scanToken() {
         case '"': return handleString();
     }
 
-    return errorToken("Unexpected character.");
+    return errorToken(errorMessages[1]);
+}
+
+void initTokenBuffer(TokenBuffer *tokens) {
+    tokens->source = NULL;
+    tokens->types = NULL;
+    tokens->offsets = NULL;
+    tokens->lengths = NULL;
+    tokens->lineDeltas = NULL;
+    tokens->count = 0;
+    tokens->capacity = 0;
+}
+
+void freeTokenBuffer(TokenBuffer *tokens) {
+    FREE_ARRAY(uint8_t, tokens->types, tokens->capacity, MEM_COMPILER);
+    FREE_ARRAY(int, tokens->offsets, tokens->capacity, MEM_COMPILER);
+    FREE_ARRAY(int, tokens->lengths, tokens->capacity, MEM_COMPILER);
+    FREE_ARRAY(int, tokens->lineDeltas, tokens->capacity, MEM_COMPILER);
+    initTokenBuffer(tokens);
+}
+
+static void appendToken(TokenBuffer *tokens, TokenType type, int offset,
+                        int length, int lineDelta)
+{
+    if (tokens->capacity < tokens->count + 1) {
+        int oldCapacity = tokens->capacity;
+        tokens->capacity = GROW_CAPACITY(oldCapacity);
+        tokens->types = GROW_ARRAY(uint8_t, tokens->types, oldCapacity,
+                                   tokens->capacity, MEM_COMPILER);
+        tokens->offsets = GROW_ARRAY(int, tokens->offsets, oldCapacity,
+                                     tokens->capacity, MEM_COMPILER);
+        tokens->lengths = GROW_ARRAY(int, tokens->lengths, oldCapacity,
+                                     tokens->capacity, MEM_COMPILER);
+        tokens->lineDeltas = GROW_ARRAY(int, tokens->lineDeltas, oldCapacity,
+                                        tokens->capacity, MEM_COMPILER);
+    }
+
+    tokens->types[tokens->count] = (uint8_t)type;
+    tokens->offsets[tokens->count] = offset;
+    tokens->lengths[tokens->count] = length;
+    tokens->lineDeltas[tokens->count] = lineDelta;
+    tokens->count++;
+}
+
+Token tokenAt(TokenBuffer *tokens, int index, int line) {
+    Token token;
+    token.type = (TokenType)tokens->types[index];
+    token.start = token.type == TOKEN_ERROR
+        ? errorMessages[tokens->offsets[index]]
+        : tokens->source + tokens->offsets[index];
+    token.length = tokens->lengths[index];
+    token.line = line;
+
+    return token;
+}
+
+// One piece of a source, lexed with lines counted from its start
+typedef struct {
+    const char *source;
+    const char *start;
+    const char *end;
+    TokenBuffer *tokens;
+    int lastLine; // Of the last token appended
+    int lines; // Newlines in the piece
+    MemoryStats stats; // Parallel workers account apart from the caller
+} LexJob;
+
+static void lexRange(LexJob *job) {
+    initRange(job->start, job->end);
+    job->lastLine = 0;
+
+    for (;;) {
+        Token token = scanToken();
+        if (token.type == TOKEN_EOF) break;
+
+        int offset = (int)(token.start - job->source);
+        if (token.type == TOKEN_ERROR)
+            offset = token.start == errorMessages[0] ? 0 : 1;
+
+        appendToken(job->tokens, token.type, offset, token.length,
+                    token.line - job->lastLine);
+        job->lastLine = token.line;
+    }
+
+    job->lines = lexer.line;
+}
+
+static void *lexWorker(void *argument) {
+    LexJob *job = argument;
+    MemoryStats *previous = setMemoryStats(&job->stats);
+    lexRange(job);
+    setMemoryStats(previous);
+
+    return NULL;
+}
+
+// Picks up to pieces - 1 split points, each just past a newline outside
+// strings and comments, so every piece starts where a token can. This
+// only tracks quotes and comments, a fraction of the work of lexing.
+static int splitSource(const char *source, size_t length, int pieces,
+                       const char **bounds)
+{
+    size_t target = length / pieces;
+    bool inString = false;
+    bool inComment = false;
+    int count = 1;
+
+    bounds[0] = source;
+    for (size_t i = 0; i < length && count < pieces; i++) {
+        switch (source[i]) {
+            case '"':
+                if (!inComment) inString = !inString;
+                break;
+            case '/':
+                if (!inString && source[i + 1] == '/') inComment = true;
+                break;
+            case '\n':
+                inComment = false;
+                if (!inString && i + 1 >= target * count)
+                    bounds[count++] = source + i + 1;
+                break;
+        }
+    }
+    bounds[count] = source + length;
+
+    return count;
+}
+
+// Lexes the pieces concurrently, then appends them to tokens in order,
+// rebasing each piece's first line delta onto the one before
+static int lexParallel(const char *source, size_t length, int threads,
+                       TokenBuffer *tokens)
+{
+    const char *bounds[LEX_THREADS_MAX + 1];
+    int pieces = splitSource(source, length, threads, bounds);
+
+    LexJob jobs[LEX_THREADS_MAX];
+    TokenBuffer buffers[LEX_THREADS_MAX];
+    pthread_t workers[LEX_THREADS_MAX];
+    bool started[LEX_THREADS_MAX];
+    for (int i = 0; i < pieces; i++) {
+        initTokenBuffer(&buffers[i]);
+        jobs[i] = (LexJob){
+            .source = source,
+            .start = bounds[i],
+            .end = bounds[i + 1],
+            .tokens = &buffers[i],
+        };
+        started[i] = pthread_create(&workers[i], NULL, lexWorker,
+                                    &jobs[i]) == 0;
+    }
+
+    int pieceLine = 0; // Line each piece starts on
+    int lastLine = 0;
+    for (int i = 0; i < pieces; i++) {
+        // A piece whose worker could not start is lexed here instead
+        if (started[i]) {
+            pthread_join(workers[i], NULL);
+        }
+        else {
+            lexWorker(&jobs[i]);
+        }
+
+        TokenBuffer *piece = &buffers[i];
+        int line = pieceLine;
+        for (int j = 0; j < piece->count; j++) {
+            line += piece->lineDeltas[j];
+            appendToken(tokens, piece->types[j], piece->offsets[j],
+                        piece->lengths[j], line - lastLine);
+            lastLine = line;
+        }
+        pieceLine += jobs[i].lines;
+
+        // Freed against the stats it was allocated under
+        MemoryStats *previous = setMemoryStats(&jobs[i].stats);
+        freeTokenBuffer(piece);
+        setMemoryStats(previous);
+    }
+
+    return pieceLine - lastLine;
+}
+
+void lexSource(const char *source, TokenBuffer *tokens, int threads) {
+    size_t length = strlen(source);
+    tokens->source = source;
+    if (threads > LEX_THREADS_MAX) threads = LEX_THREADS_MAX;
+
+    int eofDelta;
+    if (threads > 1 && length >= LEX_PARALLEL_MIN) {
+        eofDelta = lexParallel(source, length, threads, tokens);
+    }
+    else {
+        LexJob job = {
+            .source = source,
+            .start = source,
+            .end = source + length,
+            .tokens = tokens,
+        };
+        lexRange(&job);
+        eofDelta = job.lines - job.lastLine;
+    }
+
+    appendToken(tokens, TOKEN_EOF, (int)length, 0, eofDelta);
 }
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "common.h"
+
 typedef enum {
   // Single-character tokens.
   TOKEN_LEFT_PAREN, TOKEN_RIGHT_PAREN,
   TOKEN_LEFT_BRACE, TOKEN_RIGHT_BRACE,
+  TOKEN_LEFT_BRACKET, TOKEN_RIGHT_BRACKET,
   TOKEN_COMMA, TOKEN_DOT, TOKEN_MINUS, TOKEN_PLUS,
   TOKEN_SEMICOLON, TOKEN_SLASH, TOKEN_STAR,
   // One or two character tokens.
@@ -29,5 +32,25 @@ typedef struct {
     int line;
 } Token;
 
+// Every token of a source, stored column by column so the parser's
+// type checks stay within one dense array
+typedef struct {
+    const char *source;
+    uint8_t *types;
+    int *offsets; // Into source, or lexer messages for TOKEN_ERROR
+    int *lengths;
+    int *lineDeltas; // From the previous token's line
+    int count;
+    int capacity;
+} TokenBuffer;
+
 void initLexer(const char *source);
 Token scanToken();
+
+void initTokenBuffer(TokenBuffer *tokens);
+void freeTokenBuffer(TokenBuffer *tokens);
+// Lexes all of source, ending with TOKEN_EOF. Large sources are split
+// across up to threads threads.
+void lexSource(const char *source, TokenBuffer *tokens, int threads);
+// Rebuilds the token at index, given the line the caller tracked to it
+Token tokenAt(TokenBuffer *tokens, int index, int line);
@@ -0,0 +1,288 @@
+#include "server.h"
+#include "Core/output.h"
+#include "VM/vm.h"
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Wire format: the client writes the source and shuts down its write
+// side. The server answers with a ResponseHeader, then the captured
+// stdout bytes, then the captured stderr bytes.
+typedef struct {
+    int32_t status;
+    uint32_t outLength;
+    uint32_t errLength;
+} ResponseHeader;
+
+static bool writeAll(int fd, const void *data, size_t length) {
+    const char *bytes = data;
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written <= 0) return false;
+        bytes += written;
+        length -= written;
+    }
+
+    return true;
+}
+
+static bool readAll(int fd, void *data, size_t length) {
+    char *bytes = data;
+    while (length > 0) {
+        ssize_t got = read(fd, bytes, length);
+        if (got <= 0) return false;
+        bytes += got;
+        length -= got;
+    }
+
+    return true;
+}
+
+// Largest script a client may send
+#define REQUEST_MAX (16 * 1024 * 1024)
+
+// Reads until EOF into a null-terminated heap buffer. On failure sets
+// *error, or leaves it NULL when the connection itself broke; an
+// oversized request is still read to the end so the client can hear
+// why it was rejected.
+static char *readToEnd(int fd, const char **error) {
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *buffer = malloc(capacity);
+    *error = NULL;
+    if (buffer == NULL) {
+        *error = "Out of memory reading request.";
+        return NULL;
+    }
+
+    for (;;) {
+        if (length + 1 == capacity) {
+            if (capacity >= REQUEST_MAX) {
+                *error = "Request too large.";
+                break;
+            }
+
+            char *grown = realloc(buffer, capacity * 2);
+            if (grown == NULL) {
+                *error = "Out of memory reading request.";
+                break;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+
+        ssize_t got = read(fd, buffer + length, capacity - length - 1);
+        if (got < 0) {
+            free(buffer);
+            return NULL;
+        }
+        if (got == 0) break;
+        length += got;
+    }
+
+    if (*error != NULL) {
+        // Drain the rest into the buffer we already have
+        while (read(fd, buffer, capacity) > 0) {}
+        free(buffer);
+        return NULL;
+    }
+
+    buffer[length] = '\0';
+    return buffer;
+}
+
+// Answers a request that never ran with just a message on stderr
+static void sendError(int fd, const char *message) {
+    ResponseHeader header;
+    header.status = 65; // Data error
+    header.outLength = 0;
+    header.errLength = (uint32_t)strlen(message) + 1;
+
+    if (writeAll(fd, &header, sizeof(header)) &&
+        writeAll(fd, message, header.errLength - 1))
+    {
+        writeAll(fd, "\n", 1);
+    }
+}
+
+static int makeAddress(const char *socketPath, struct sockaddr_un *address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "Socket path too long \"%s\".\n", socketPath);
+        return -1;
+    }
+
+    strcpy(address->sun_path, socketPath);
+    return 0;
+}
+
+static bool sendCaptured(int fd, FILE *file, uint32_t length) {
+    char buffer[4096];
+    rewind(file);
+    while (length > 0) {
+        size_t chunk = length < sizeof(buffer) ? length : sizeof(buffer);
+        if (fread(buffer, 1, chunk, file) != chunk) return false;
+        if (!writeAll(fd, buffer, chunk)) return false;
+        length -= chunk;
+    }
+
+    return true;
+}
+
+static int exitStatus(InterpretResult result) {
+    switch (result) {
+        case INTERPRET_COMPILE_ERROR: return 65; // Data error
+        case INTERPRET_RUNTIME_ERROR: return 70;
+        default: return 0;
+    }
+}
+
+static void handleConnection(int fd) {
+    const char *error;
+    char *source = readToEnd(fd, &error);
+    if (source == NULL) {
+        if (error != NULL) sendError(fd, error);
+        return;
+    }
+
+    FILE *out = tmpfile();
+    FILE *err = tmpfile();
+    if (out == NULL || err == NULL) {
+        if (out != NULL) fclose(out);
+        if (err != NULL) fclose(err);
+        free(source);
+        return;
+    }
+
+    // Point fds 1 and 2 at the capture files for this request only
+    fflush(stdout);
+    fflush(stderr);
+    int savedOut = dup(STDOUT_FILENO);
+    int savedErr = dup(STDERR_FILENO);
+    dup2(fileno(out), STDOUT_FILENO);
+    dup2(fileno(err), STDERR_FILENO);
+
+    InterpretResult result = interpret(source);
+    while (result == INTERPRET_YIELD) result = resumeInterpret();
+
+    flushOutput();
+    fflush(stdout);
+    fflush(stderr);
+    dup2(savedOut, STDOUT_FILENO);
+    dup2(savedErr, STDERR_FILENO);
+    close(savedOut);
+    close(savedErr);
+    free(source);
+
+    // Nothing a request allocated outlives it
+    resetVM();
+
+    ResponseHeader header;
+    header.status = exitStatus(result);
+    header.outLength = (uint32_t)ftell(out);
+    header.errLength = (uint32_t)ftell(err);
+
+    if (writeAll(fd, &header, sizeof(header)) &&
+        sendCaptured(fd, out, header.outLength))
+    {
+        sendCaptured(fd, err, header.errLength);
+    }
+
+    fclose(out);
+    fclose(err);
+}
+
+int serve(const char *socketPath) {
+    struct sockaddr_un address;
+    if (makeAddress(socketPath, &address) != 0) return 74;
+
+    // A client hanging up early must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 74;
+    }
+
+    unlink(socketPath); // Stale socket from a previous run
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0)
+    {
+        perror(socketPath);
+        close(listener);
+        return 74;
+    }
+
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) continue;
+
+        handleConnection(fd);
+        close(fd);
+    }
+}
+
+int runClient(const char *socketPath, const char *scriptPath) {
+    FILE *file = fopen(scriptPath, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file \"%s\".\n", scriptPath);
+        return 74; // I/0 error
+    }
+
+    struct sockaddr_un address;
+    if (makeAddress(socketPath, &address) != 0) {
+        fclose(file);
+        return 74;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 ||
+        connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0)
+    {
+        perror(socketPath);
+        if (fd >= 0) close(fd);
+        fclose(file);
+        return 74;
+    }
+
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        if (!writeAll(fd, buffer, length)) break;
+    }
+    fclose(file);
+    shutdown(fd, SHUT_WR);
+
+    ResponseHeader header;
+    if (!readAll(fd, &header, sizeof(header))) {
+        fprintf(stderr, "No response from \"%s\".\n", socketPath);
+        close(fd);
+        return 74;
+    }
+
+    uint32_t lengths[] = {header.outLength, header.errLength};
+    FILE *streams[] = {stdout, stderr};
+    for (int i = 0; i < 2; i++) {
+        while (lengths[i] > 0) {
+            size_t chunk = lengths[i] < sizeof(buffer)
+                ? lengths[i] : sizeof(buffer);
+            if (!readAll(fd, buffer, chunk)) {
+                close(fd);
+                return 74;
+            }
+            fwrite(buffer, 1, chunk, streams[i]);
+            lengths[i] -= chunk;
+        }
+    }
+
+    close(fd);
+    return header.status;
+}
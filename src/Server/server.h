@@ -0,0 +1,10 @@
+#pragma once
+
+#include "common.h"
+
+// Serves interpret() requests on a Unix domain socket, keeping the VM
+// warm between them. Only returns on a fatal socket error.
+int serve(const char *socketPath);
+// Sends one script to a running server, relays its output and returns
+// the exit status the script would have had when run directly
+int runClient(const char *socketPath, const char *scriptPath);
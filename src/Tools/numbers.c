@@ -0,0 +1,195 @@
+// clox-numbers: checks Core/number.c bit for bit against libc, and with
+// --bench times both
+#include "common.h"
+#include "Core/number.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CHECK_COUNT 300000
+#define BENCH_COUNT 2000000
+#define LITERAL_MAX 48
+
+static uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+// xorshift64*, seeded the same every run so failures reproduce
+static uint64_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+
+    return state * 0x2545f4914f6cdd1dULL;
+}
+
+// Any finite double, from subnormals to the largest
+static double randomDouble() {
+    for (;;) {
+        uint64_t bits = next();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (isfinite(value)) return value;
+    }
+}
+
+static bool sameBits(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// A literal the lexer accepts: digits with an optional fraction. Short
+// ones, like most in scripts, stay on parseDouble's fast path.
+static int randomLiteral(char *buffer, bool isShort) {
+    int whole = 1 + (int)(next() % (isShort ? 8 : 20));
+    int fraction = (int)(next() % (isShort ? 7 : 24));
+    int length = 0;
+
+    for (int i = 0; i < whole; i++) buffer[length++] = '0' + next() % 10;
+    if (fraction > 0) {
+        buffer[length++] = '.';
+        for (int i = 0; i < fraction; i++)
+            buffer[length++] = '0' + next() % 10;
+    }
+    buffer[length] = '\0';
+
+    return length;
+}
+
+static long long nanoseconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (long long)time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+// Significant digits in a formatted number, exponent aside
+static int significantDigits(const char *buffer) {
+    int digits = 0;
+    bool leading = true;
+    for (const char *c = buffer; *c != '\0' && *c != 'e'; c++) {
+        if (*c < '0' || *c > '9') continue;
+        if (*c != '0') leading = false;
+        if (!leading) digits++;
+    }
+
+    return digits;
+}
+
+// formatDouble must read back to the same bits as %.17g does, with no
+// more significant digits
+static int checkFormat() {
+    int failures = 0;
+    char buffer[NUMBER_BUFFER_SIZE + 1];
+    char libc[NUMBER_BUFFER_SIZE];
+
+    for (int i = 0; i < CHECK_COUNT; i++) {
+        double value = randomDouble();
+        int length = formatDouble(value, buffer);
+        buffer[length] = '\0';
+        snprintf(libc, sizeof(libc), "%.17g", value);
+
+        if (!sameBits(strtod(buffer, NULL), strtod(libc, NULL)) ||
+            !sameBits(strtod(buffer, NULL), value) ||
+            significantDigits(buffer) > 17)
+        {
+            if (failures++ < 10)
+                fprintf(stderr, "formatDouble: %s for %s\n", buffer, libc);
+        }
+    }
+
+    return failures;
+}
+
+// parseDouble must agree with strtod bit for bit, parseInteger with
+// strtoll wherever the literal is an integer that fits
+static int checkParse() {
+    int failures = 0;
+    char literal[LITERAL_MAX];
+
+    for (int i = 0; i < CHECK_COUNT; i++) {
+        int length = randomLiteral(literal, i % 2 == 0);
+        if (!sameBits(parseDouble(literal, length), strtod(literal, NULL))) {
+            if (failures++ < 10)
+                fprintf(stderr, "parseDouble: %s\n", literal);
+        }
+
+        int64_t value;
+        bool parsed = parseInteger(literal, length, &value);
+        errno = 0;
+        long long expected = strtoll(literal, NULL, 10);
+        bool fits = strchr(literal, '.') == NULL && errno != ERANGE;
+        if (parsed != fits || (parsed && value != expected)) {
+            if (failures++ < 10)
+                fprintf(stderr, "parseInteger: %s\n", literal);
+        }
+    }
+
+    return failures;
+}
+
+static void bench() {
+    double *values = malloc(sizeof(double) * BENCH_COUNT);
+    for (int i = 0; i < BENCH_COUNT; i++) values[i] = randomDouble();
+
+    char buffer[NUMBER_BUFFER_SIZE];
+    size_t sink = 0;
+    long long start = nanoseconds();
+    for (int i = 0; i < BENCH_COUNT; i++)
+        sink += formatDouble(values[i], buffer);
+    long long ours = nanoseconds() - start;
+
+    start = nanoseconds();
+    for (int i = 0; i < BENCH_COUNT; i++)
+        sink += snprintf(buffer, sizeof(buffer), "%.17g", values[i]);
+    long long theirs = nanoseconds() - start;
+    printf("format      %6.1f ns  snprintf %6.1f ns  (%.1fx)\n",
+           (double)ours / BENCH_COUNT, (double)theirs / BENCH_COUNT,
+           (double)theirs / ours);
+
+    char (*literals)[LITERAL_MAX] = malloc(LITERAL_MAX * BENCH_COUNT);
+    int *lengths = malloc(sizeof(int) * BENCH_COUNT);
+    double total = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        bool isShort = pass == 0;
+        for (int i = 0; i < BENCH_COUNT; i++)
+            lengths[i] = randomLiteral(literals[i], isShort);
+
+        start = nanoseconds();
+        for (int i = 0; i < BENCH_COUNT; i++)
+            total += parseDouble(literals[i], lengths[i]);
+        ours = nanoseconds() - start;
+
+        start = nanoseconds();
+        for (int i = 0; i < BENCH_COUNT; i++)
+            total += strtod(literals[i], NULL);
+        theirs = nanoseconds() - start;
+        printf("parse %-5s %6.1f ns  strtod   %6.1f ns  (%.1fx)\n",
+               isShort ? "short" : "long", (double)ours / BENCH_COUNT,
+               (double)theirs / BENCH_COUNT, (double)theirs / ours);
+    }
+
+    // Keeps the loops from being optimized away
+    if (sink == 0 && total == 0) printf("\n");
+
+    free(values);
+    free(literals);
+    free(lengths);
+}
+
+int main(int argc, const char *argv[]) {
+    if (argc == 2 && strcmp(argv[1], "--bench") == 0) {
+        bench();
+        return 0;
+    }
+    if (argc != 1) {
+        fprintf(stderr, "Usage: clox-numbers [--bench]\n");
+        return 64; // Command line usage error
+    }
+
+    int failures = checkFormat() + checkParse();
+    printf("%d checks, %d failed\n", 2 * CHECK_COUNT, failures);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+// clox-stat: reads the counters a clox started with --metrics publishes,
+// without stopping it
+#include "common.h"
+#include "Core/metrics.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// The counters at one instant
+typedef struct {
+    uint64_t allocations;
+    uint64_t bytesAllocated;
+    uint64_t bytesFreed;
+    uint64_t objectsAllocated;
+    uint64_t objectsFreed;
+    uint64_t instructions;
+    uint64_t compiles;
+    uint64_t compileErrors;
+    uint64_t compileNanoseconds;
+    uint64_t runtimeErrors;
+} Sample;
+
+static void usage() {
+    fprintf(stderr, "Usage: clox-stat file [interval-ms [count]]\n");
+    exit(64); // Command line usage error
+}
+
+static const Metrics *openPage(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open file \"%s\".\n", path);
+        exit(74); // I/0 error
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Metrics)) {
+        fprintf(stderr, "Invalid metrics file \"%s\".\n", path);
+        exit(65); // Data error
+    }
+
+    const Metrics *page = mmap(NULL, sizeof(Metrics), PROT_READ, MAP_SHARED,
+                               fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        fprintf(stderr, "Could not map file \"%s\".\n", path);
+        exit(74);
+    }
+
+    if (memcmp(page->magic, METRICS_MAGIC, sizeof(page->magic)) != 0 ||
+        page->version != METRICS_VERSION || page->size != sizeof(Metrics))
+    {
+        fprintf(stderr, "Invalid metrics file \"%s\".\n", path);
+        exit(65);
+    }
+
+    return page;
+}
+
+#define LOAD(counter) \
+    atomic_load_explicit((_Atomic uint64_t*)&page->counter, \
+                         memory_order_relaxed)
+
+static Sample takeSample(const Metrics *page) {
+    Sample sample;
+    sample.allocations = LOAD(allocations);
+    sample.bytesAllocated = LOAD(bytesAllocated);
+    sample.bytesFreed = LOAD(bytesFreed);
+    sample.objectsAllocated = LOAD(objectsAllocated);
+    sample.objectsFreed = LOAD(objectsFreed);
+    sample.instructions = LOAD(instructions);
+    sample.compiles = LOAD(compiles);
+    sample.compileErrors = LOAD(compileErrors);
+    sample.compileNanoseconds = LOAD(compileNanoseconds);
+    sample.runtimeErrors = LOAD(runtimeErrors);
+
+    return sample;
+}
+
+#undef LOAD
+
+// Counters are read one by one, so a free can be seen before the
+// allocation it undoes
+static uint64_t live(uint64_t allocated, uint64_t freed) {
+    return allocated > freed ? allocated - freed : 0;
+}
+
+static bool running(const Metrics *page) {
+    return kill((pid_t)page->pid, 0) == 0 || errno == EPERM;
+}
+
+static double seconds() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void printTotals(const Metrics *page) {
+    Sample sample = takeSample(page);
+
+    printf("pid %lld, %s\n", (long long)page->pid,
+           running(page) ? "running" : "exited");
+    printf("  instructions     %20llu\n",
+           (unsigned long long)sample.instructions);
+    printf("  allocations      %20llu\n",
+           (unsigned long long)sample.allocations);
+    printf("  bytes allocated  %20llu\n",
+           (unsigned long long)sample.bytesAllocated);
+    printf("  bytes live       %20llu\n", (unsigned long long)live(
+           sample.bytesAllocated, sample.bytesFreed));
+    printf("  objects          %20llu\n",
+           (unsigned long long)sample.objectsAllocated);
+    printf("  objects live     %20llu\n", (unsigned long long)live(
+           sample.objectsAllocated, sample.objectsFreed));
+    printf("  compiles         %20llu\n",
+           (unsigned long long)sample.compiles);
+    printf("  compile errors   %20llu\n",
+           (unsigned long long)sample.compileErrors);
+    printf("  compile time     %17.3f ms\n",
+           sample.compileNanoseconds / 1e6);
+    printf("  runtime errors   %20llu\n",
+           (unsigned long long)sample.runtimeErrors);
+}
+
+// One line of rates per interval until the process exits or count
+// lines are printed, if count is positive
+static void watch(const Metrics *page, int interval, int count) {
+    printf("%12s %12s %12s %12s %12s %8s %8s\n", "instr/s", "allocs/s",
+           "KB/s", "live KB", "live objs", "compiles", "errors");
+
+    Sample last = takeSample(page);
+    double lastTime = seconds();
+    for (int printed = 0; count <= 0 || printed < count; printed++) {
+        bool alive = running(page);
+        if (alive) usleep((useconds_t)interval * 1000);
+
+        Sample sample = takeSample(page);
+        double now = seconds();
+        double elapsed = now - lastTime;
+
+        printf("%12.0f %12.0f %12.1f %12.1f %12llu %8llu %8llu\n",
+               (sample.instructions - last.instructions) / elapsed,
+               (sample.allocations - last.allocations) / elapsed,
+               (sample.bytesAllocated - last.bytesAllocated) / elapsed /
+                   1024,
+               live(sample.bytesAllocated, sample.bytesFreed) / 1024.0,
+               (unsigned long long)live(sample.objectsAllocated,
+                                        sample.objectsFreed),
+               (unsigned long long)(sample.compiles - last.compiles),
+               (unsigned long long)(
+                   sample.compileErrors - last.compileErrors +
+                   sample.runtimeErrors - last.runtimeErrors));
+        fflush(stdout);
+
+        if (!alive) break;
+        last = sample;
+        lastTime = now;
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    if (argc < 2 || argc > 4) usage();
+
+    const Metrics *page = openPage(argv[1]);
+    if (argc == 2) {
+        printTotals(page);
+        return 0;
+    }
+
+    int interval = atoi(argv[2]);
+    int count = argc == 4 ? atoi(argv[3]) : 0;
+    if (interval < 1) usage();
+
+    watch(page, interval, count);
+    return 0;
+}
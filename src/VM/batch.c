@@ -0,0 +1,763 @@
+#include "batch.h"
+#include "Core/array.h"
+#include "Core/cpu.h"
+#include "Core/heap.h"
+#include "Core/memory.h"
+#include "Core/metrics.h"
+#include "Core/number.h"
+#include "Core/object.h"
+#include "Core/sequence.h"
+#include "Core/utf8.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Blocks each worker past the first needs before it is worth a thread
+#define BLOCKS_PER_WORKER 16
+#define BATCH_COLUMNS_MAX (UINT8_MAX + 1)
+
+typedef enum {
+    LANES_UNIFORM, // Every lane holds uniform, as constants do
+    LANES_DOUBLES, // Unboxed, for the SIMD kernels
+    LANES_VALUES,
+} LaneKind;
+
+// One stack slot across a block of rows; only kind's storage is live
+typedef struct {
+    LaneKind kind;
+    Value uniform;
+    double doubles[BATCH_LANES];
+    Value values[BATCH_LANES];
+} Lanes;
+
+struct BatchWorker {
+    Chunk *chunk;
+    const BatchColumn *columns;
+    BatchResult *result;
+    int first; // Rows this worker evaluates
+    int rows;
+    Lanes *stack;
+    int stackSize;
+    double scratch[2 * BATCH_LANES]; // Uniform operands spread out
+    ObjectHeap heap; // Objects its rows create
+    MemoryStats stats;
+};
+
+// One ISA's kernels, each over a whole block of lanes
+typedef void (*LaneKernel)(double *out, const double *a, const double *b);
+
+typedef struct {
+    LaneKernel add;
+    LaneKernel subtract;
+    LaneKernel multiply;
+    LaneKernel divide;
+} Kernels;
+
+#ifndef HAS_SIMD
+
+#define SCALAR_KERNEL(name, op) \
+    static void name(double *out, const double *a, const double *b) { \
+        for (int i = 0; i < BATCH_LANES; i++) out[i] = a[i] op b[i]; \
+    }
+
+SCALAR_KERNEL(addScalar, +)
+SCALAR_KERNEL(subtractScalar, -)
+SCALAR_KERNEL(multiplyScalar, *)
+SCALAR_KERNEL(divideScalar, /)
+
+static const Kernels scalarKernels = {
+    addScalar, subtractScalar, multiplyScalar, divideScalar
+};
+
+#else
+
+#define SSE2_KERNEL(name, intrinsic) \
+    static void name(double *out, const double *a, const double *b) { \
+        for (int i = 0; i < BATCH_LANES; i += 2) { \
+            _mm_storeu_pd(out + i, intrinsic(_mm_loadu_pd(a + i), \
+                                             _mm_loadu_pd(b + i))); \
+        } \
+    }
+
+SSE2_KERNEL(addSse2, _mm_add_pd)
+SSE2_KERNEL(subtractSse2, _mm_sub_pd)
+SSE2_KERNEL(multiplySse2, _mm_mul_pd)
+SSE2_KERNEL(divideSse2, _mm_div_pd)
+
+static const Kernels sse2Kernels = {
+    addSse2, subtractSse2, multiplySse2, divideSse2
+};
+
+#define AVX2_KERNEL(name, intrinsic) \
+    AVX2 static void name(double *out, const double *a, const double *b) { \
+        for (int i = 0; i < BATCH_LANES; i += 4) { \
+            _mm256_storeu_pd(out + i, intrinsic(_mm256_loadu_pd(a + i), \
+                                                _mm256_loadu_pd(b + i))); \
+        } \
+    }
+
+AVX2_KERNEL(addAvx2, _mm256_add_pd)
+AVX2_KERNEL(subtractAvx2, _mm256_sub_pd)
+AVX2_KERNEL(multiplyAvx2, _mm256_mul_pd)
+AVX2_KERNEL(divideAvx2, _mm256_div_pd)
+
+static const Kernels avx2Kernels = {
+    addAvx2, subtractAvx2, multiplyAvx2, divideAvx2
+};
+
+#endif
+
+static const Kernels *kernels() {
+#ifdef HAS_SIMD
+    return cpuHasAvx2() ? &avx2Kernels : &sse2Kernels;
+#else
+    return &scalarKernels;
+#endif
+}
+
+// Quickened and unchecked forms behave as their generic opcode does
+static uint8_t genericOp(uint8_t op) {
+    switch (op) {
+        case OP_ADD_NN:
+        case OP_ADD_INT:
+        case OP_ADD_NUM:
+        case OP_ADD_STR:
+        case OP_CONCAT:
+            return OP_ADD;
+        case OP_SUBTRACT_NN:
+        case OP_SUBTRACT_INT:
+        case OP_SUBTRACT_NUM:
+            return OP_SUBTRACT;
+        case OP_MULTIPLY_NN:
+        case OP_MULTIPLY_INT:
+        case OP_MULTIPLY_NUM:
+            return OP_MULTIPLY;
+        case OP_DIVIDE_NN:
+        case OP_DIVIDE_NUM:
+            return OP_DIVIDE;
+        case OP_LESS_NN:
+        case OP_LESS_INT:
+        case OP_LESS_NUM:
+            return OP_LESS;
+        case OP_GREATER_NN:
+        case OP_GREATER_INT:
+        case OP_GREATER_NUM:
+            return OP_GREATER;
+        case OP_NEGATE_N: return OP_NEGATE;
+        default: return op;
+    }
+}
+
+static bool isFalsey(Value value) {
+    return IS_NIL(value) || (IS_BOOL(value) && !AS_BOOL(value));
+}
+
+// Int-int arithmetic stays exact unless it overflows, as in run()
+static const char *arithmetic(uint8_t op, Value a, Value b, Value *result) {
+    if (!IS_NUMBER(a) || !IS_NUMBER(b)) return "Operands must be numbers.";
+
+    int64_t exact;
+    bool overflow = true;
+    if (IS_INT(a) && IS_INT(b)) {
+        switch (op) {
+            case OP_ADD:
+                overflow = __builtin_add_overflow(AS_INT(a), AS_INT(b),
+                                                  &exact);
+                break;
+            case OP_SUBTRACT:
+                overflow = __builtin_sub_overflow(AS_INT(a), AS_INT(b),
+                                                  &exact);
+                break;
+            case OP_MULTIPLY:
+                overflow = intMultiplyOverflow(AS_INT(a), AS_INT(b),
+                                               &exact);
+                break;
+        }
+    }
+    if (!overflow) {
+        *result = MAKE_INT_VAL(exact);
+        return NULL;
+    }
+
+    double x = AS_NUMBER(a);
+    double y = AS_NUMBER(b);
+    switch (op) {
+        case OP_ADD: *result = MAKE_NUMBER_VAL(x + y); break;
+        case OP_SUBTRACT: *result = MAKE_NUMBER_VAL(x - y); break;
+        case OP_MULTIPLY: *result = MAKE_NUMBER_VAL(x * y); break;
+        default: *result = MAKE_NUMBER_VAL(x / y); break;
+    }
+    return NULL;
+}
+
+// One lane of op, with run()'s semantics and error messages
+static const char *applyScalar(uint8_t op, Value a, Value b, Value *result) {
+    switch (op) {
+        case OP_EQUAL:
+            *result = MAKE_BOOL_VAL(valuesEqual(a, b));
+            return NULL;
+        case OP_LESS:
+        case OP_GREATER: {
+            if (!IS_NUMBER(a) || !IS_NUMBER(b))
+                return "Operands must be numbers.";
+
+            bool less = IS_INT(a) && IS_INT(b)
+                ? AS_INT(a) < AS_INT(b) : AS_NUMBER(a) < AS_NUMBER(b);
+            bool greater = IS_INT(a) && IS_INT(b)
+                ? AS_INT(a) > AS_INT(b) : AS_NUMBER(a) > AS_NUMBER(b);
+            *result = MAKE_BOOL_VAL(op == OP_LESS ? less : greater);
+            return NULL;
+        }
+        case OP_ADD:
+            if (IS_STRING(a) && IS_STRING(b)) {
+                *result = MAKE_OBJ_VAL(
+                    concatenateStrings(AS_STRING(a), AS_STRING(b)));
+                return NULL;
+            }
+            if (isArrayArithmetic(a, b)) return arrayAdd(a, b, result);
+            if (!IS_NUMBER(a) || !IS_NUMBER(b))
+                return "Operands must be two numbers or two strings.";
+            return arithmetic(op, a, b, result);
+        case OP_MULTIPLY:
+            if (isArrayArithmetic(a, b)) return arrayMultiply(a, b, result);
+            return arithmetic(op, a, b, result);
+        case OP_SUBTRACT:
+        case OP_DIVIDE:
+            return arithmetic(op, a, b, result);
+        case OP_NOT:
+            *result = MAKE_BOOL_VAL(isFalsey(a));
+            return NULL;
+        case OP_NEGATE:
+            if (!IS_NUMBER(a)) return "Operand must be a number.";
+            // -0 and -INT64_MIN are only representable as doubles
+            if (IS_INT(a) && AS_INT(a) != 0 && AS_INT(a) != INT64_MIN) {
+                *result = MAKE_INT_VAL(-AS_INT(a));
+            }
+            else {
+                *result = MAKE_NUMBER_VAL(-AS_NUMBER(a));
+            }
+            return NULL;
+        case OP_SUM: return arraySum(a, result);
+        case OP_DOT: return arrayDot(a, b, result);
+        case OP_MIN: return arrayMin(a, result);
+        case OP_MAX: return arrayMax(a, result);
+        case OP_RANGE: return arrayRange(a, result);
+        case OP_LENGTH: return sequenceLength(a, result);
+        case OP_INDEX: return sequenceIndex(a, b, result);
+        default: return "Unknown opcode.";
+    }
+}
+
+static Value laneValue(Lanes *lanes, int lane) {
+    switch (lanes->kind) {
+        case LANES_UNIFORM: return lanes->uniform;
+        case LANES_DOUBLES: return MAKE_NUMBER_VAL(lanes->doubles[lane]);
+        default: return lanes->values[lane];
+    }
+}
+
+static void setUniform(Lanes *lanes, Value value) {
+    lanes->kind = LANES_UNIFORM;
+    lanes->uniform = value;
+}
+
+static void copyLanes(Lanes *to, Lanes *from, int count) {
+    to->kind = from->kind;
+    to->uniform = from->uniform;
+    if (from->kind == LANES_DOUBLES)
+        memcpy(to->doubles, from->doubles, sizeof(double) * count);
+    if (from->kind == LANES_VALUES)
+        memcpy(to->values, from->values, sizeof(Value) * count);
+}
+
+static void loadColumn(Lanes *lanes, const BatchColumn *column, int first,
+                       int count)
+{
+    if (column->numbers != NULL) {
+        lanes->kind = LANES_DOUBLES;
+        memcpy(lanes->doubles, column->numbers + first,
+               sizeof(double) * count);
+    }
+    else {
+        lanes->kind = LANES_VALUES;
+        memcpy(lanes->values, column->values + first,
+               sizeof(Value) * count);
+    }
+}
+
+// Both sides fit the kernels, and at least one is not a constant
+static bool isUnboxable(Lanes *a, Lanes *b) {
+    bool left = a->kind == LANES_DOUBLES ||
+                (a->kind == LANES_UNIFORM && IS_NUMBER(a->uniform));
+    bool right = b->kind == LANES_DOUBLES ||
+                 (b->kind == LANES_UNIFORM && IS_NUMBER(b->uniform));
+
+    return left && right &&
+           (a->kind == LANES_DOUBLES || b->kind == LANES_DOUBLES);
+}
+
+static const double *unboxed(Lanes *lanes, double *scratch) {
+    if (lanes->kind == LANES_DOUBLES) return lanes->doubles;
+
+    double number = AS_NUMBER(lanes->uniform);
+    for (int i = 0; i < BATCH_LANES; i++) scratch[i] = number;
+    return scratch;
+}
+
+// With a double on either side the result is always a double, so the
+// kernels match run() lane for lane. Lanes that already failed compute
+// garbage doubles, which nothing reads.
+static void unboxedBinary(BatchWorker *worker, uint8_t op, Lanes *a,
+                          Lanes *b)
+{
+    const double *left = unboxed(a, worker->scratch);
+    const double *right = unboxed(b, worker->scratch + BATCH_LANES);
+
+    if (op == OP_LESS || op == OP_GREATER) {
+        for (int i = 0; i < BATCH_LANES; i++) {
+            a->values[i] = MAKE_BOOL_VAL(
+                op == OP_LESS ? left[i] < right[i] : left[i] > right[i]);
+        }
+        a->kind = LANES_VALUES;
+        return;
+    }
+
+    const Kernels *selected = kernels();
+    switch (op) {
+        case OP_ADD: selected->add(a->doubles, left, right); break;
+        case OP_SUBTRACT: selected->subtract(a->doubles, left, right); break;
+        case OP_MULTIPLY: selected->multiply(a->doubles, left, right); break;
+        default: selected->divide(a->doubles, left, right); break;
+    }
+    a->kind = LANES_DOUBLES;
+}
+
+// Lane by lane into a, or once when every operand is uniform. b is
+// NULL for unary opcodes.
+static void boxed(uint8_t op, Lanes *a, Lanes *b, const char **errors,
+                  int count)
+{
+    Value nil = MAKE_NIL_VAL;
+
+    if (a->kind == LANES_UNIFORM && (b == NULL || b->kind == LANES_UNIFORM)) {
+        Value result;
+        const char *error = applyScalar(op, a->uniform,
+                                        b != NULL ? b->uniform : nil,
+                                        &result);
+        if (error == NULL) {
+            a->uniform = result;
+            return;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (errors[i] == NULL) errors[i] = error;
+        }
+        a->uniform = nil;
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        Value result = nil;
+        if (errors[i] == NULL) {
+            const char *error = applyScalar(
+                op, laneValue(a, i), b != NULL ? laneValue(b, i) : nil,
+                &result);
+            if (error != NULL) {
+                errors[i] = error;
+                result = nil;
+            }
+        }
+        a->values[i] = result;
+    }
+    a->kind = LANES_VALUES;
+}
+
+static void evaluateBlock(BatchWorker *worker, int first, int count) {
+    Chunk *chunk = worker->chunk;
+    uint8_t *code = chunk->code;
+    Lanes *stack = worker->stack;
+    const char **errors = worker->result->errors + first;
+    int top = 0; // Slots in use
+    uint64_t executed = 0;
+
+    for (int offset = 0; offset < chunk->count;
+         offset += instructionSize(chunk, offset))
+    {
+        executed++;
+        uint8_t op = genericOp(code[offset]);
+        switch (op) {
+            case OP_CONSTANT:
+                setUniform(&stack[top++],
+                           chunk->constants.values[code[offset + 1]]);
+                break;
+            case OP_NIL: setUniform(&stack[top++], MAKE_NIL_VAL); break;
+            case OP_TRUE: setUniform(&stack[top++], MAKE_BOOL_VAL(true)); break;
+            case OP_FALSE:
+                setUniform(&stack[top++], MAKE_BOOL_VAL(false));
+                break;
+            case OP_COLUMN:
+                loadColumn(&stack[top++], &worker->columns[code[offset + 1]],
+                           first, count);
+                break;
+            case OP_GET_LOCAL:
+                copyLanes(&stack[top++], &stack[code[offset + 1]], count);
+                break;
+            case OP_SET_LOCAL:
+                copyLanes(&stack[code[offset + 1]], &stack[top - 1], count);
+                break;
+            case OP_RETURN: {
+                Value *values = worker->result->values + first;
+                for (int i = 0; i < count; i++) {
+                    values[i] = errors[i] != NULL
+                        ? MAKE_NIL_VAL : laneValue(&stack[top - 1], i);
+                }
+                // As many as the rows would have run one at a time
+                COUNT_METRIC(instructions, executed * count);
+                return;
+            }
+            case OP_ADD:
+            case OP_SUBTRACT:
+            case OP_MULTIPLY:
+            case OP_DIVIDE:
+            case OP_LESS:
+            case OP_GREATER:
+                if (isUnboxable(&stack[top - 2], &stack[top - 1])) {
+                    unboxedBinary(worker, op, &stack[top - 2],
+                                  &stack[top - 1]);
+                }
+                else {
+                    boxed(op, &stack[top - 2], &stack[top - 1], errors,
+                          count);
+                }
+                top--;
+                break;
+            case OP_NEGATE:
+                if (stack[top - 1].kind == LANES_DOUBLES) {
+                    double *doubles = stack[top - 1].doubles;
+                    for (int i = 0; i < BATCH_LANES; i++)
+                        doubles[i] = -doubles[i];
+                    break;
+                }
+                boxed(op, &stack[top - 1], NULL, errors, count);
+                break;
+            default:
+                if (stackEffect(chunk, offset) == 0) {
+                    boxed(op, &stack[top - 1], NULL, errors, count);
+                }
+                else {
+                    boxed(op, &stack[top - 2], &stack[top - 1], errors,
+                          count);
+                    top--;
+                }
+                break;
+        }
+    }
+}
+
+static void *runWorker(void *argument) {
+    BatchWorker *worker = argument;
+    ObjectHeap *previousHeap = setObjectHeap(&worker->heap);
+    MemoryStats *previousStats = setMemoryStats(&worker->stats);
+
+    // Zeroed so lanes past a short last block hold harmless doubles
+    worker->stack = ALLOCATE(Lanes, worker->stackSize, MEM_BATCH);
+    memset(worker->stack, 0, sizeof(Lanes) * worker->stackSize);
+
+    int end = worker->first + worker->rows;
+    for (int row = worker->first; row < end; row += BATCH_LANES) {
+        int count = end - row < BATCH_LANES ? end - row : BATCH_LANES;
+        evaluateBlock(worker, row, count);
+    }
+
+    FREE_ARRAY(Lanes, worker->stack, worker->stackSize, MEM_BATCH);
+    worker->stack = NULL;
+
+    setMemoryStats(previousStats);
+    setObjectHeap(previousHeap);
+    return NULL;
+}
+
+void evaluateBatch(Chunk *chunk, const BatchColumn *columns, int rows,
+                   int threads, BatchResult *result)
+{
+    int blocks = (rows + BATCH_LANES - 1) / BATCH_LANES;
+    int workers = blocks / BLOCKS_PER_WORKER;
+    if (workers > threads) workers = threads;
+    if (workers < 1) workers = 1;
+
+    result->rows = rows;
+    result->values = ALLOCATE(Value, rows, MEM_BATCH);
+    result->errors = ALLOCATE(const char*, rows, MEM_BATCH);
+    if (rows > 0) memset(result->errors, 0, sizeof(const char*) * rows);
+    result->failures = 0;
+    result->workerCount = workers;
+    result->workers = ALLOCATE(BatchWorker, workers, MEM_BATCH);
+    memset(result->workers, 0, sizeof(BatchWorker) * workers);
+
+    // Whole blocks per worker, so only the last block may be short
+    for (int i = 0; i < workers; i++) {
+        BatchWorker *worker = &result->workers[i];
+        int first = blocks * i / workers * BATCH_LANES;
+        int end = blocks * (i + 1) / workers * BATCH_LANES;
+        if (end > rows) end = rows;
+
+        worker->chunk = chunk;
+        worker->columns = columns;
+        worker->result = result;
+        worker->first = first;
+        worker->rows = end - first;
+        worker->stackSize = chunk->stackDepth;
+    }
+
+    pthread_t *handles = ALLOCATE(pthread_t, workers, MEM_BATCH);
+    bool *started = ALLOCATE(bool, workers, MEM_BATCH);
+    for (int i = 1; i < workers; i++) {
+        started[i] = pthread_create(&handles[i], NULL, runWorker,
+                                    &result->workers[i]) == 0;
+    }
+    runWorker(&result->workers[0]);
+    for (int i = 1; i < workers; i++) {
+        // A worker that could not start runs here instead
+        if (started[i]) {
+            pthread_join(handles[i], NULL);
+        }
+        else {
+            runWorker(&result->workers[i]);
+        }
+    }
+    FREE_ARRAY(pthread_t, handles, workers, MEM_BATCH);
+    FREE_ARRAY(bool, started, workers, MEM_BATCH);
+
+    for (int row = 0; row < rows; row++) {
+        if (result->errors[row] != NULL) result->failures++;
+    }
+}
+
+void freeBatchResult(BatchResult *result) {
+    for (int i = 0; i < result->workerCount; i++) {
+        BatchWorker *worker = &result->workers[i];
+        MemoryStats *previous = setMemoryStats(&worker->stats);
+        freeHeap(&worker->heap);
+        setMemoryStats(previous);
+    }
+
+    FREE_ARRAY(BatchWorker, result->workers, result->workerCount, MEM_BATCH);
+    FREE_ARRAY(Value, result->values, result->rows, MEM_BATCH);
+    FREE_ARRAY(const char*, result->errors, result->rows, MEM_BATCH);
+    result->workers = NULL;
+    result->workerCount = 0;
+    result->rows = 0;
+}
+
+typedef struct {
+    const char *start;
+    int length;
+} Field;
+
+// Splits text into lines of comma-separated fields, skipping blank
+// lines. Quotes are not special, so no field can hold a comma. Returns
+// the number of lines, or -1 when they differ in width.
+static int splitCsv(const char *text, Field **fields, int *capacity,
+                    int *width)
+{
+    int count = 0;
+    int lines = 0;
+    *width = 0;
+
+    const char *line = text;
+    while (*line != '\0') {
+        const char *end = strchr(line, '\n');
+        if (end == NULL) end = line + strlen(line);
+        const char *next = *end == '\n' ? end + 1 : end;
+        if (end > line && end[-1] == '\r') end--;
+        if (end == line) {
+            line = next;
+            continue;
+        }
+
+        int lineFields = 0;
+        const char *start = line;
+        for (;;) {
+            const char *comma = memchr(start, ',', end - start);
+            const char *stop = comma != NULL ? comma : end;
+
+            if (*capacity < count + 1) {
+                int oldCapacity = *capacity;
+                *capacity = GROW_CAPACITY(oldCapacity);
+                *fields = GROW_ARRAY(Field, *fields, oldCapacity, *capacity,
+                                     MEM_COMPILER);
+            }
+            (*fields)[count].start = start;
+            (*fields)[count].length = (int)(stop - start);
+            count++;
+            lineFields++;
+
+            if (comma == NULL) break;
+            start = comma + 1;
+        }
+
+        if (lines == 0) *width = lineFields;
+        if (lineFields != *width) return -1;
+        lines++;
+        line = next;
+    }
+
+    return lines;
+}
+
+static bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// True when the field is a number literal as the lexer reads one,
+// optionally negated: digits with an optional fraction, so no spaces,
+// exponents, hex, inf or nan. The number is what the script's literal
+// would evaluate to: an int when it is integral and fits, else a double.
+static bool parseNumberField(Field field, Value *number) {
+    const char *start = field.start;
+    int length = field.length;
+    bool negative = length > 0 && start[0] == '-';
+    if (negative) {
+        start++;
+        length--;
+    }
+
+    int i = 0;
+    while (i < length && isDigit(start[i])) i++;
+    if (i == 0) return false;
+
+    if (i < length && start[i] == '.') {
+        int fraction = ++i;
+        while (i < length && isDigit(start[i])) i++;
+        if (i == fraction) return false;
+    }
+    if (i != length) return false;
+
+    // Negating int 0 yields a double -0, as OP_NEGATE does
+    int64_t integer;
+    if (parseInteger(start, length, &integer) &&
+        !(negative && integer == 0))
+    {
+        *number = MAKE_INT_VAL(negative ? -integer : integer);
+    }
+    else {
+        double value = parseDouble(start, length);
+        *number = MAKE_NUMBER_VAL(negative ? -value : value);
+    }
+
+    return true;
+}
+
+const char *parseCsv(const char *text, BatchTable *table) {
+    Field *fields = NULL;
+    int capacity = 0;
+    int width;
+    int lines = splitCsv(text, &fields, &capacity, &width);
+
+    const char *error = NULL;
+    if (lines < 0) error = "Rows must all have as many fields as the header.";
+    else if (lines == 0) error = "Missing header row.";
+    else if (width > BATCH_COLUMNS_MAX) error = "Too many columns.";
+
+    // A script could only ever read the first of two same-named columns
+    for (int i = 0; error == NULL && i < width; i++) {
+        for (int j = 0; j < i; j++) {
+            if (fields[i].length == fields[j].length &&
+                memcmp(fields[i].start, fields[j].start,
+                       fields[i].length) == 0)
+            {
+                error = "Duplicate column name.";
+                break;
+            }
+        }
+    }
+
+    for (int i = width; error == NULL && i < lines * width; i++) {
+        if (!validateUtf8(fields[i].start, fields[i].length, &(int){0}))
+            error = "Invalid UTF-8 in field.";
+    }
+
+    if (error != NULL) {
+        FREE_ARRAY(Field, fields, capacity, MEM_COMPILER);
+        return error;
+    }
+
+    table->columnCount = width;
+    table->rows = lines - 1;
+    table->names = ALLOCATE(char*, width, MEM_BATCH);
+    table->columns = ALLOCATE(BatchColumn, width, MEM_BATCH);
+
+    for (int column = 0; column < width; column++) {
+        Field name = fields[column];
+        table->names[column] = ALLOCATE(char, name.length + 1, MEM_BATCH);
+        memcpy(table->names[column], name.start, name.length);
+        table->names[column][name.length] = '\0';
+
+        bool numeric = true;
+        bool integral = true;
+        Value number;
+        for (int row = 1; row < lines && numeric; row++) {
+            numeric = parseNumberField(fields[row * width + column],
+                                       &number);
+            integral = integral && numeric && IS_INT(number);
+        }
+
+        BatchColumn *batchColumn = &table->columns[column];
+        if (numeric && !integral) {
+            double *numbers = ALLOCATE(double, table->rows, MEM_BATCH);
+            for (int row = 1; row < lines; row++) {
+                parseNumberField(fields[row * width + column], &number);
+                numbers[row - 1] = AS_NUMBER(number);
+            }
+            batchColumn->numbers = numbers;
+            batchColumn->values = NULL;
+        }
+        else if (numeric) {
+            // Boxed, so they stay exact past 2^53
+            Value *values = ALLOCATE(Value, table->rows, MEM_BATCH);
+            for (int row = 1; row < lines; row++) {
+                parseNumberField(fields[row * width + column],
+                                 &values[row - 1]);
+            }
+            batchColumn->numbers = NULL;
+            batchColumn->values = values;
+        }
+        else {
+            Value *values = ALLOCATE(Value, table->rows, MEM_BATCH);
+            for (int row = 1; row < lines; row++) {
+                Field field = fields[row * width + column];
+                values[row - 1] = MAKE_OBJ_VAL(
+                    copyString(field.start, field.length));
+            }
+            batchColumn->numbers = NULL;
+            batchColumn->values = values;
+        }
+    }
+
+    FREE_ARRAY(Field, fields, capacity, MEM_COMPILER);
+    return NULL;
+}
+
+void freeBatchTable(BatchTable *table) {
+    for (int column = 0; column < table->columnCount; column++) {
+        FREE_ARRAY(char, table->names[column],
+                   strlen(table->names[column]) + 1, MEM_BATCH);
+
+        // Strings stay in the VM heap, like any other object
+        BatchColumn *batchColumn = &table->columns[column];
+        if (batchColumn->numbers != NULL) {
+            FREE_ARRAY(double, (double*)batchColumn->numbers, table->rows,
+                       MEM_BATCH);
+        }
+        else {
+            FREE_ARRAY(Value, (Value*)batchColumn->values, table->rows,
+                       MEM_BATCH);
+        }
+    }
+
+    FREE_ARRAY(char*, table->names, table->columnCount, MEM_BATCH);
+    FREE_ARRAY(BatchColumn, table->columns, table->columnCount, MEM_BATCH);
+    table->columnCount = 0;
+    table->rows = 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Chunk/chunk.h"
+#include "Core/value.h"
+#include "common.h"
+
+// Rows evaluated together, one lane each
+#define BATCH_LANES 256
+
+// One input column with a value per row: plain doubles, which the
+// numeric opcodes run over with SIMD, or arbitrary values
+typedef struct {
+    const double *numbers; // Used when not NULL
+    const Value *values;
+} BatchColumn;
+
+typedef struct BatchWorker BatchWorker;
+
+// What a batch evaluated to, row by row. Objects the values reference
+// live in the workers' heaps until freeBatchResult().
+typedef struct {
+    int rows;
+    Value *values; // nil where the row failed
+    const char **errors; // The runtime error of each failed row, else NULL
+    int failures;
+    BatchWorker *workers;
+    int workerCount;
+} BatchResult;
+
+// Columns read from CSV text whose first line names them. A column
+// whose every field is an integer holds ints, one whose every field is
+// a number with some fractions holds doubles, and any other strings.
+typedef struct {
+    int columnCount;
+    int rows;
+    char **names;
+    BatchColumn *columns;
+} BatchTable;
+
+// Runs chunk, compiled by compileColumns(), once per row: each opcode
+// runs across BATCH_LANES rows at a time, a type error failing only its
+// own rows. Batches of many blocks are split across up to threads
+// workers.
+void evaluateBatch(Chunk *chunk, const BatchColumn *columns, int rows,
+                   int threads, BatchResult *result);
+void freeBatchResult(BatchResult *result);
+
+// Returns the error message, or NULL when table was filled in
+const char *parseCsv(const char *text, BatchTable *table);
+void freeBatchTable(BatchTable *table);
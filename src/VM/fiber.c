@@ -0,0 +1,124 @@
+#include "fiber.h"
+#include "Core/memory.h"
+#include "Frontend/compiler.h"
+#include "vm.h"
+
+void initScheduler(Scheduler *scheduler) {
+    scheduler->head = NULL;
+    scheduler->tail = NULL;
+    scheduler->count = 0;
+    scheduler->spawned = 0;
+    scheduler->slice = FIBER_SLICE_DEFAULT;
+}
+
+void freeFiber(Fiber *fiber) {
+    freeChunk(&fiber->chunk);
+    FREE_ARRAY(Value, fiber->stack, fiber->stackSize, MEM_FIBERS);
+    FREE(Fiber, fiber, MEM_FIBERS);
+}
+
+void freeScheduler(Scheduler *scheduler) {
+    Fiber *fiber = scheduler->head;
+    while (fiber != NULL) {
+        Fiber *next = fiber->next;
+        freeFiber(fiber);
+        fiber = next;
+    }
+
+    int slice = scheduler->slice;
+    initScheduler(scheduler);
+    scheduler->slice = slice;
+}
+
+static void enqueue(Scheduler *scheduler, Fiber *fiber) {
+    fiber->next = NULL;
+    if (scheduler->tail != NULL) {
+        scheduler->tail->next = fiber;
+    }
+    else {
+        scheduler->head = fiber;
+    }
+    scheduler->tail = fiber;
+    scheduler->count++;
+}
+
+static Fiber *dequeue(Scheduler *scheduler) {
+    Fiber *fiber = scheduler->head;
+    scheduler->head = fiber->next;
+    if (scheduler->head == NULL) scheduler->tail = NULL;
+    scheduler->count--;
+
+    return fiber;
+}
+
+// Gives a fiber whose chunk is in place its stack and registers
+static void startFiber(Fiber *fiber) {
+    fiber->stackSize = fiber->chunk.stackDepth;
+    fiber->stack = ALLOCATE(Value, fiber->stackSize, MEM_FIBERS);
+    fiber->stackTop = fiber->stack;
+    fiber->ip = fiber->chunk.code;
+    fiber->id = vm.scheduler.spawned++;
+    fiber->chunkId = vm.chunksLoaded++;
+}
+
+Fiber *newFiber(const char *source) {
+    Fiber *fiber = ALLOCATE(Fiber, 1, MEM_FIBERS);
+    initChunk(&fiber->chunk);
+
+    if (!compile(source, &fiber->chunk)) {
+        freeChunk(&fiber->chunk);
+        FREE(Fiber, fiber, MEM_FIBERS);
+
+        return NULL;
+    }
+
+    startFiber(fiber);
+    return fiber;
+}
+
+Fiber *spawnFiber(Chunk *chunk) {
+    Fiber *fiber = ALLOCATE(Fiber, 1, MEM_FIBERS);
+    // Shares the code and constants; freeChunk() will not touch them
+    fiber->chunk = *chunk;
+
+    startFiber(fiber);
+    enqueue(&vm.scheduler, fiber);
+
+    return fiber;
+}
+
+InterpretResult runFiber(Fiber *fiber, int instructions) {
+    // Switch the VM's registers to the fiber for one slice
+    vm.chunk = &fiber->chunk;
+    vm.chunkId = fiber->chunkId;
+    vm.ip = fiber->ip;
+    vm.stackBase = fiber->stack;
+    vm.stackTop = fiber->stackTop;
+
+    InterpretResult result = runSlice(instructions);
+    fiber->ip = vm.ip;
+    fiber->stackTop = vm.stackTop;
+
+    resetStack();
+    return result;
+}
+
+int runFibers() {
+    Scheduler *scheduler = &vm.scheduler;
+    int failures = 0;
+
+    while (scheduler->head != NULL) {
+        Fiber *fiber = dequeue(scheduler);
+
+        InterpretResult result = runFiber(fiber, scheduler->slice);
+        if (result == INTERPRET_YIELD) {
+            enqueue(scheduler, fiber);
+            continue;
+        }
+
+        if (result != INTERPRET_OK) failures++;
+        freeFiber(fiber);
+    }
+
+    return failures;
+}
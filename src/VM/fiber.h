@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Chunk/chunk.h"
+#include "Core/value.h"
+#include "common.h"
+
+#define FIBER_SLICE_DEFAULT 100
+
+// A script with its own chunk, instruction pointer and value stack.
+// The stack is sized to the chunk's exact maximum depth.
+typedef struct Fiber {
+    Chunk chunk;
+    uint8_t *ip;
+    Value *stack;
+    Value *stackTop;
+    int stackSize;
+    int id; // Spawn order, starting at 0
+    uint16_t chunkId; // vm.chunkId while it runs
+    struct Fiber *next; // Run queue link
+} Fiber;
+
+// Round-robin run queue. Each turn runs a fiber for slice instructions
+// or until it finishes, whichever comes first.
+typedef struct {
+    Fiber *head; // Runs next
+    Fiber *tail;
+    int count;
+    int spawned;
+    int slice;
+} Scheduler;
+
+void initScheduler(Scheduler *scheduler);
+// Frees fibers that never ran to completion
+void freeScheduler(Scheduler *scheduler);
+// Compiles source into a fiber that is not queued anywhere, returns
+// NULL on a compile error
+Fiber *newFiber(const char *source);
+void freeFiber(Fiber *fiber);
+// Queues a fiber at the back of vm.scheduler that runs chunk, which
+// must be frozen, in place
+Fiber *spawnFiber(Chunk *chunk);
+// Runs queued fibers until none is left, returns how many failed
+int runFibers();
@@ -0,0 +1,406 @@
+#include "jit.h"
+#include "Chunk/chunk.h"
+#include "Core/memory.h"
+#include "Core/value.h"
+#include "vm.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+
+// Baseline template JIT: every opcode becomes a fixed machine code
+// template. rbx caches vm.stackTop and r12 holds &vm.stackTop. Number
+// fast paths run inline; everything else spills rbx and calls back
+// into stepInstruction(), so runtime errors take the VM's own path.
+
+typedef struct {
+    uint8_t *bytes;
+    int count;
+    int capacity;
+} Assembler;
+
+static void emit(Assembler *as, const uint8_t *bytes, int length) {
+    if (as->capacity < as->count + length) {
+        int oldCapacity = as->capacity;
+        while (as->capacity < as->count + length)
+            as->capacity = GROW_CAPACITY(as->capacity);
+        as->bytes = GROW_ARRAY(uint8_t, as->bytes,
+                               oldCapacity, as->capacity, MEM_COMPILER);
+    }
+
+    memcpy(as->bytes + as->count, bytes, length);
+    as->count += length;
+}
+
+#define EMIT(as, ...) \
+    do { \
+        const uint8_t bytes_[] = {__VA_ARGS__}; \
+        emit(as, bytes_, sizeof(bytes_)); \
+    } while (false)
+
+static void emit32(Assembler *as, uint32_t value) {
+    emit(as, (const uint8_t*)&value, 4);
+}
+
+static void emit64(Assembler *as, uint64_t value) {
+    emit(as, (const uint8_t*)&value, 8);
+}
+
+// Emits a rel32 jump opcode and returns the offset to patch
+static int emitJump(Assembler *as, const uint8_t *opcode, int length) {
+    emit(as, opcode, length);
+    emit32(as, 0);
+
+    return as->count - 4;
+}
+
+static int jumpIfNotEqual(Assembler *as) {
+    return emitJump(as, (const uint8_t[]){0x0F, 0x85}, 2);
+}
+
+static int jumpIfEqual(Assembler *as) {
+    return emitJump(as, (const uint8_t[]){0x0F, 0x84}, 2);
+}
+
+static int jumpIfOverflow(Assembler *as) {
+    return emitJump(as, (const uint8_t[]){0x0F, 0x80}, 2);
+}
+
+static int jump(Assembler *as) {
+    return emitJump(as, (const uint8_t[]){0xE9}, 1);
+}
+
+// Points the rel32 at patch to the current position
+static void patchJump(Assembler *as, int patch) {
+    int32_t offset = as->count - (patch + 4);
+    memcpy(as->bytes + patch, &offset, 4);
+}
+
+static void patchJumpTo(Assembler *as, int patch, int target) {
+    int32_t offset = target - (patch + 4);
+    memcpy(as->bytes + patch, &offset, 4);
+}
+
+// cmp dword [rbx + displacement], type
+static void checkType(Assembler *as, int8_t displacement, ValueType type) {
+    EMIT(as, 0x83, 0x7B, (uint8_t)displacement, (uint8_t)type);
+}
+
+// Jumps to the slow path unless both operands have the given type
+static void checkOperands(Assembler *as, ValueType type,
+                          int *slow, int *slowCount)
+{
+    checkType(as, -16, type);
+    slow[(*slowCount)++] = jumpIfNotEqual(as);
+    checkType(as, -32, type);
+    slow[(*slowCount)++] = jumpIfNotEqual(as);
+}
+
+// Falls back to the interpreter for the instruction at ip
+static void emitSlowPath(Assembler *as, uint8_t *ip, int *exits,
+                         int *exitCount)
+{
+    EMIT(as, 0x49, 0x89, 0x1C, 0x24); // mov [r12], rbx
+    EMIT(as, 0x48, 0xBF); // mov rdi, ip
+    emit64(as, (uint64_t)(uintptr_t)ip);
+    EMIT(as, 0x48, 0xB8); // mov rax, stepInstruction
+    emit64(as, (uint64_t)(uintptr_t)stepInstruction);
+    EMIT(as, 0xFF, 0xD0); // call rax
+    EMIT(as, 0x49, 0x8B, 0x1C, 0x24); // mov rbx, [r12]
+    EMIT(as, 0x85, 0xC0); // test eax, eax
+    exits[(*exitCount)++] = jumpIfNotEqual(as);
+}
+
+static void pushImmediate(Assembler *as, ValueType type, int32_t payload) {
+    EMIT(as, 0xC7, 0x03); // mov dword [rbx], type
+    emit32(as, (uint32_t)type);
+    EMIT(as, 0x48, 0xC7, 0x43, 0x08); // mov qword [rbx + 8], payload
+    emit32(as, (uint32_t)payload);
+    EMIT(as, 0x48, 0x83, 0xC3, 0x10); // add rbx, 16
+}
+
+// Int-int then double-double inline paths for an arithmetic opcode
+static void emitArithmetic(Assembler *as, uint8_t intOp, uint8_t doubleOp,
+                           int *slow, int *slowCount, int *done,
+                           int *doneCount)
+{
+    if (intOp != 0) {
+        checkType(as, -16, VAL_INT);
+        int notInt = jumpIfNotEqual(as);
+        checkType(as, -32, VAL_INT);
+        int notInt2 = jumpIfNotEqual(as);
+        EMIT(as, 0x48, 0x8B, 0x43, 0xE8); // mov rax, [rbx - 24]
+        if (intOp == 0xAF) {
+            EMIT(as, 0x48, 0x0F, 0xAF, 0x43, 0xF8); // imul rax, [rbx - 8]
+            slow[(*slowCount)++] = jumpIfOverflow(as);
+            // A zero product may be -0, which the slow path works out
+            EMIT(as, 0x48, 0x85, 0xC0); // test rax, rax
+            slow[(*slowCount)++] = jumpIfEqual(as);
+        }
+        else {
+            EMIT(as, 0x48, intOp, 0x43, 0xF8); // add/sub rax, [rbx - 8]
+            slow[(*slowCount)++] = jumpIfOverflow(as);
+        }
+        EMIT(as, 0x48, 0x89, 0x43, 0xE8); // mov [rbx - 24], rax
+        EMIT(as, 0x48, 0x83, 0xEB, 0x10); // sub rbx, 16
+        done[(*doneCount)++] = jump(as);
+        patchJump(as, notInt);
+        patchJump(as, notInt2);
+    }
+
+    checkOperands(as, VAL_NUMBER, slow, slowCount);
+    EMIT(as, 0xF2, 0x0F, 0x10, 0x43, 0xE8); // movsd xmm0, [rbx - 24]
+    EMIT(as, 0xF2, 0x0F, doubleOp, 0x43, 0xF8); // op xmm0, [rbx - 8]
+    EMIT(as, 0xF2, 0x0F, 0x11, 0x43, 0xE8); // movsd [rbx - 24], xmm0
+    EMIT(as, 0x48, 0x83, 0xEB, 0x10); // sub rbx, 16
+    done[(*doneCount)++] = jump(as);
+}
+
+// Int-int and double-double inline paths for OP_LESS/OP_GREATER
+static void emitComparison(Assembler *as, bool less,
+                           int *slow, int *slowCount, int *done,
+                           int *doneCount)
+{
+    checkType(as, -16, VAL_INT);
+    int notInt = jumpIfNotEqual(as);
+    checkType(as, -32, VAL_INT);
+    int notInt2 = jumpIfNotEqual(as);
+    EMIT(as, 0x48, 0x8B, 0x43, 0xE8); // mov rax, [rbx - 24]
+    EMIT(as, 0x48, 0x3B, 0x43, 0xF8); // cmp rax, [rbx - 8]
+    EMIT(as, 0x0F, less ? 0x9C : 0x9F, 0xC0); // setl/setg al
+    int store = jump(as);
+    patchJump(as, notInt);
+    patchJump(as, notInt2);
+
+    checkOperands(as, VAL_NUMBER, slow, slowCount);
+    // a < b is evaluated as b > a so NaN compares false
+    if (less) {
+        EMIT(as, 0xF2, 0x0F, 0x10, 0x43, 0xF8); // movsd xmm0, [rbx - 8]
+        EMIT(as, 0x66, 0x0F, 0x2E, 0x43, 0xE8); // ucomisd xmm0, [rbx - 24]
+    }
+    else {
+        EMIT(as, 0xF2, 0x0F, 0x10, 0x43, 0xE8); // movsd xmm0, [rbx - 24]
+        EMIT(as, 0x66, 0x0F, 0x2E, 0x43, 0xF8); // ucomisd xmm0, [rbx - 8]
+    }
+    EMIT(as, 0x0F, 0x97, 0xC0); // seta al
+
+    patchJump(as, store);
+    EMIT(as, 0x0F, 0xB6, 0xC0); // movzx eax, al
+    EMIT(as, 0xC7, 0x43, 0xE0); // mov dword [rbx - 32], VAL_BOOL
+    emit32(as, VAL_BOOL);
+    EMIT(as, 0x48, 0x89, 0x43, 0xE8); // mov [rbx - 24], rax
+    EMIT(as, 0x48, 0x83, 0xEB, 0x10); // sub rbx, 16
+    done[(*doneCount)++] = jump(as);
+}
+
+static bool translate(Chunk *chunk, Assembler *as) {
+    // Every exit needs patching, at most one per instruction byte
+    int *exits = ALLOCATE(int, chunk->count + 1, MEM_COMPILER);
+    int exitCount = 0;
+    bool supported = true;
+
+    EMIT(as, 0x53); // push rbx
+    EMIT(as, 0x41, 0x54); // push r12
+    EMIT(as, 0x48, 0x83, 0xEC, 0x08); // sub rsp, 8 (keeps alignment)
+    EMIT(as, 0x49, 0xBC); // mov r12, &vm.stackTop
+    emit64(as, (uint64_t)(uintptr_t)&vm.stackTop);
+    EMIT(as, 0x49, 0x8B, 0x1C, 0x24); // mov rbx, [r12]
+
+    for (int offset = 0; offset < chunk->count && supported;) {
+        uint8_t *ip = &chunk->code[offset];
+        int slow[8];
+        int slowCount = 0;
+        int done[4];
+        int doneCount = 0;
+        bool hasSlowPath = true;
+
+        switch (*ip) {
+            case OP_CONSTANT: {
+                Value *constant = &chunk->constants.values[ip[1]];
+                EMIT(as, 0x48, 0xB8); // mov rax, constant
+                emit64(as, (uint64_t)(uintptr_t)constant);
+                EMIT(as, 0x0F, 0x10, 0x00); // movups xmm0, [rax]
+                EMIT(as, 0x0F, 0x11, 0x03); // movups [rbx], xmm0
+                EMIT(as, 0x48, 0x83, 0xC3, 0x10); // add rbx, 16
+                hasSlowPath = false;
+                break;
+            }
+            case OP_GET_LOCAL: {
+                EMIT(as, 0x48, 0xB8); // mov rax, &vm.stack[slot]
+                emit64(as, (uint64_t)(uintptr_t)&vm.stack[ip[1]]);
+                EMIT(as, 0x0F, 0x10, 0x00); // movups xmm0, [rax]
+                EMIT(as, 0x0F, 0x11, 0x03); // movups [rbx], xmm0
+                EMIT(as, 0x48, 0x83, 0xC3, 0x10); // add rbx, 16
+                hasSlowPath = false;
+                break;
+            }
+            case OP_SET_LOCAL: {
+                EMIT(as, 0x48, 0xB8); // mov rax, &vm.stack[slot]
+                emit64(as, (uint64_t)(uintptr_t)&vm.stack[ip[1]]);
+                EMIT(as, 0x0F, 0x10, 0x43, 0xF0); // movups xmm0, [rbx - 16]
+                EMIT(as, 0x0F, 0x11, 0x00); // movups [rax], xmm0
+                hasSlowPath = false;
+                break;
+            }
+            case OP_NIL:
+                pushImmediate(as, VAL_NIL, 0);
+                hasSlowPath = false;
+                break;
+            case OP_TRUE:
+                pushImmediate(as, VAL_BOOL, 1);
+                hasSlowPath = false;
+                break;
+            case OP_FALSE:
+                pushImmediate(as, VAL_BOOL, 0);
+                hasSlowPath = false;
+                break;
+            case OP_ADD:
+            case OP_ADD_NN:
+                emitArithmetic(as, 0x03, 0x58, slow, &slowCount,
+                               done, &doneCount);
+                break;
+            case OP_SUBTRACT:
+            case OP_SUBTRACT_NN:
+                emitArithmetic(as, 0x2B, 0x5C, slow, &slowCount,
+                               done, &doneCount);
+                break;
+            case OP_MULTIPLY:
+            case OP_MULTIPLY_NN:
+                emitArithmetic(as, 0xAF, 0x59, slow, &slowCount,
+                               done, &doneCount);
+                break;
+            case OP_DIVIDE:
+            case OP_DIVIDE_NN:
+                // Int division yields a double, leave it to the VM
+                emitArithmetic(as, 0, 0x5E, slow, &slowCount,
+                               done, &doneCount);
+                break;
+            case OP_LESS:
+            case OP_LESS_NN:
+            case OP_GREATER:
+            case OP_GREATER_NN:
+                emitComparison(as, *ip == OP_LESS || *ip == OP_LESS_NN,
+                               slow, &slowCount, done, &doneCount);
+                break;
+            case OP_EQUAL:
+            case OP_NOT:
+            case OP_NEGATE:
+            case OP_NEGATE_N:
+            case OP_SUM:
+            case OP_DOT:
+            case OP_MIN:
+            case OP_MAX:
+            case OP_RANGE:
+            case OP_LENGTH:
+            case OP_INDEX:
+            case OP_CONCAT:
+            case OP_RETURN:
+                break;
+            default:
+                // Quickened or unknown opcodes are not templated
+                supported = false;
+                continue;
+        }
+
+        if (hasSlowPath) {
+            for (int i = 0; i < slowCount; i++)
+                patchJump(as, slow[i]);
+            emitSlowPath(as, ip, exits, &exitCount);
+            for (int i = 0; i < doneCount; i++)
+                patchJump(as, done[i]);
+        }
+
+        if (*ip == OP_RETURN) {
+            // stepInstruction() already printed the result
+            exits[exitCount++] = jump(as);
+        }
+
+        offset += instructionSize(chunk, offset);
+    }
+
+    // Shared epilogue, eax holds the InterpretResult
+    int epilogue = as->count;
+    EMIT(as, 0x48, 0x83, 0xC4, 0x08); // add rsp, 8
+    EMIT(as, 0x41, 0x5C); // pop r12
+    EMIT(as, 0x5B); // pop rbx
+    EMIT(as, 0xC3); // ret
+
+    for (int i = 0; i < exitCount; i++)
+        patchJumpTo(as, exits[i], epilogue);
+
+    FREE_ARRAY(int, exits, chunk->count + 1, MEM_COMPILER);
+    return supported;
+}
+
+bool jitCompile(Chunk *chunk, JitCode *jit) {
+    // Templates hardcode the Value layout
+    if (sizeof(Value) != 16 || offsetof(Value, as) != 8)
+        return false;
+
+    Assembler as = {NULL, 0, 0};
+    if (!translate(chunk, &as)) {
+        FREE_ARRAY(uint8_t, as.bytes, as.capacity, MEM_COMPILER);
+
+        return false;
+    }
+
+    void *code = mmap(NULL, as.count, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        FREE_ARRAY(uint8_t, as.bytes, as.capacity, MEM_COMPILER);
+
+        return false;
+    }
+
+    memcpy(code, as.bytes, as.count);
+    FREE_ARRAY(uint8_t, as.bytes, as.capacity, MEM_COMPILER);
+
+    // W^X: the mapping is never writable and executable at once
+    if (mprotect(code, as.count, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, as.count);
+
+        return false;
+    }
+
+    jit->code = code;
+    jit->size = as.count;
+    return true;
+}
+
+InterpretResult jitRun(JitCode *jit) {
+    InterpretResult (*function)(void) =
+        (InterpretResult (*)(void))jit->code;
+
+    return function();
+}
+
+void jitFree(JitCode *jit) {
+    munmap(jit->code, jit->size);
+    jit->code = NULL;
+    jit->size = 0;
+}
+
+#else
+
+bool jitCompile(Chunk *chunk, JitCode *jit) {
+    (void)chunk;
+    (void)jit;
+
+    return false;
+}
+
+InterpretResult jitRun(JitCode *jit) {
+    (void)jit;
+
+    return INTERPRET_RUNTIME_ERROR;
+}
+
+void jitFree(JitCode *jit) {
+    (void)jit;
+}
+
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Chunk/chunk.h"
+#include "vm.h"
+
+// Native code for one chunk, produced by the baseline JIT
+typedef struct {
+    void *code; // Executable mapping
+    size_t size;
+} JitCode;
+
+// Returns false when the platform or an opcode is unsupported, in
+// which case the caller falls back to the interpreter
+bool jitCompile(Chunk *chunk, JitCode *jit);
+InterpretResult jitRun(JitCode *jit);
+void jitFree(JitCode *jit);
@@ -0,0 +1,282 @@
+#include "snapshot.h"
+#include "Chunk/verify.h"
+#include "Core/memory.h"
+#include "Core/object.h"
+#include "Core/utf8.h"
+#include "Core/value.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNAPSHOT_MAGIC "CLOXSNAP"
+#define SNAPSHOT_VERSION 3
+// Pointers in a file are written for a mapping at this address, so a
+// snapshot that gets it needs no relocation at all
+#define SNAPSHOT_BASE ((uintptr_t)0x3c0000000000)
+#define SNAPSHOT_ALIGN 16
+
+// File layout: header, code, lines, objects, then the constant pool.
+// Objects come before the constants so their addresses are known by
+// the time the constants are written.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t valueSize; // Rejects files from builds with another Value
+    uint64_t size; // Of the whole file
+    uint32_t codeCount;
+    uint32_t constantCount;
+    // Section offsets from the start of the file
+    uint64_t code;
+    uint64_t lines;
+    uint64_t constants;
+} SnapshotHeader;
+
+typedef struct {
+    FILE *file;
+    uint64_t offset;
+    bool failed;
+} Writer;
+
+static void writeBytes(Writer *writer, const void *bytes, size_t size) {
+    if (size > 0 && fwrite(bytes, 1, size, writer->file) != size)
+        writer->failed = true;
+    writer->offset += size;
+}
+
+static void align(Writer *writer) {
+    static const uint8_t zeros[SNAPSHOT_ALIGN] = {0};
+    writeBytes(writer, zeros, -writer->offset & (SNAPSHOT_ALIGN - 1));
+}
+
+// Copies object and its payload, returns the copy's mapped address
+static Obj *writeObject(Writer *writer, Obj *object) {
+    align(writer);
+    uintptr_t address = SNAPSHOT_BASE + writer->offset;
+
+    switch (object->type) {
+        case OBJ_STRING: {
+            ObjString *string = (ObjString*)object;
+            ObjString copy = *string;
+            // Views come out as flat strings the mapping owns
+            copy.source = NULL;
+            copy.chars = (char*)(address + sizeof(ObjString));
+
+            writeBytes(writer, &copy, sizeof(copy));
+            writeBytes(writer, string->chars, (size_t)string->length);
+            writeBytes(writer, "", 1);
+            break;
+        }
+        case OBJ_ARRAY: {
+            ObjArray *array = (ObjArray*)object;
+            ObjArray copy = *array;
+            copy.values = (double*)(address + sizeof(ObjArray));
+
+            writeBytes(writer, &copy, sizeof(copy));
+            writeBytes(writer, array->values, sizeof(double) * array->count);
+            break;
+        }
+    }
+
+    return (Obj*)address;
+}
+
+bool saveSnapshot(Chunk *chunk, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file \"%s\".\n", path);
+        return false;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    Writer writer = {file, 0, false};
+    // Reserve the header, it is filled in once the sections are placed
+    writeBytes(&writer, &header, sizeof(header));
+
+    align(&writer);
+    header.code = writer.offset;
+    writeBytes(&writer, chunk->code, chunk->count);
+    align(&writer);
+    header.lines = writer.offset;
+    writeBytes(&writer, chunk->lines, sizeof(int) * chunk->count);
+
+    int count = chunk->constants.count;
+    Value *constants = ALLOCATE(Value, count, MEM_CONSTANTS);
+    for (int i = 0; i < count; i++) {
+        Value constant = chunk->constants.values[i];
+        // Zeroed first so padding bytes in the file are deterministic
+        memset(&constants[i], 0, sizeof(Value));
+        constants[i].type = constant.type;
+        constants[i].as = constant.as;
+
+        if (IS_OBJ(constant))
+            constants[i].as.obj = writeObject(&writer, AS_OBJ(constant));
+    }
+
+    align(&writer);
+    header.constants = writer.offset;
+    writeBytes(&writer, constants, sizeof(Value) * count);
+    FREE_ARRAY(Value, constants, count, MEM_CONSTANTS);
+
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.valueSize = sizeof(Value);
+    header.size = writer.offset;
+    header.codeCount = chunk->count;
+    header.constantCount = count;
+
+    rewind(file);
+    writeBytes(&writer, &header, sizeof(header));
+    if (fclose(file) != 0) writer.failed = true;
+
+    if (writer.failed)
+        fprintf(stderr, "Could not write snapshot \"%s\".\n", path);
+    return !writer.failed;
+}
+
+// True when size bytes at address lie inside the mapping
+static bool inMapping(Snapshot *snapshot, uintptr_t address, size_t size) {
+    uintptr_t base = (uintptr_t)snapshot->base;
+    uintptr_t end = base + snapshot->size;
+
+    return address >= base && address <= end && size <= end - address;
+}
+
+static bool validHeader(Snapshot *snapshot, SnapshotHeader *header) {
+    uintptr_t base = (uintptr_t)snapshot->base;
+
+    return memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0
+        && header->version == SNAPSHOT_VERSION
+        && header->valueSize == sizeof(Value)
+        && header->size == snapshot->size
+        && header->codeCount > 0
+        && header->lines % sizeof(int) == 0
+        && header->constants % sizeof(Value) == 0
+        && inMapping(snapshot, base + header->code, header->codeCount)
+        && inMapping(snapshot, base + header->lines,
+                     sizeof(int) * (size_t)header->codeCount)
+        && inMapping(snapshot, base + header->constants,
+                     sizeof(Value) * (size_t)header->constantCount);
+}
+
+// Moves a constant's object and payload pointers by delta, then checks
+// they stay in the mapping. Pages are only written to when delta is
+// nonzero, so an in-place mapping stays shared with the page cache.
+static bool relocate(Snapshot *snapshot, Value *constant, intptr_t delta) {
+    if (constant->type > VAL_OBJ) return false;
+    if (!IS_OBJ(*constant)) return true;
+
+    uintptr_t address = (uintptr_t)AS_OBJ(*constant) + delta;
+    if (address % SNAPSHOT_ALIGN != 0) return false;
+    if (!inMapping(snapshot, address, sizeof(Obj))) return false;
+    if (delta != 0) constant->as.obj = (Obj*)address;
+
+    switch (AS_OBJ(*constant)->type) {
+        case OBJ_STRING: {
+            ObjString *string = (ObjString*)address;
+            if (!inMapping(snapshot, address, sizeof(ObjString))) return false;
+            if (delta != 0)
+                string->chars = (char*)((uintptr_t)string->chars + delta);
+
+            // Indexing trusts codePoints and ascii, so both must match
+            // the text
+            int codePoints;
+            return string->length >= 0
+                && string->source == NULL
+                && inMapping(snapshot, (uintptr_t)string->chars,
+                             (size_t)string->length + 1)
+                && string->chars[string->length] == '\0'
+                && validateUtf8(string->chars, string->length, &codePoints)
+                && string->codePoints == codePoints
+                && string->ascii == (codePoints == string->length);
+        }
+        case OBJ_ARRAY: {
+            ObjArray *array = (ObjArray*)address;
+            if (!inMapping(snapshot, address, sizeof(ObjArray))) return false;
+            if (delta != 0)
+                array->values = (double*)((uintptr_t)array->values + delta);
+
+            return array->count >= 0
+                && (uintptr_t)array->values % sizeof(double) == 0
+                && inMapping(snapshot, (uintptr_t)array->values,
+                             sizeof(double) * (size_t)array->count);
+        }
+    }
+
+    return false;
+}
+
+bool loadSnapshot(const char *path, Snapshot *snapshot) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open file \"%s\".\n", path);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(SnapshotHeader)) {
+        fprintf(stderr, "Invalid snapshot \"%s\".\n", path);
+        close(fd);
+        return false;
+    }
+
+    // Private and writable: quickening and relocation copy just the
+    // pages they touch, everything else is faulted in from the file
+    snapshot->size = info.st_size;
+    snapshot->base = mmap((void*)SNAPSHOT_BASE, snapshot->size,
+                          PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (snapshot->base == MAP_FAILED) {
+        fprintf(stderr, "Could not map snapshot \"%s\".\n", path);
+        return false;
+    }
+
+    uint8_t *base = snapshot->base;
+    SnapshotHeader *header = snapshot->base;
+    bool valid = validHeader(snapshot, header);
+
+    // Only formed once the header puts it inside the mapping
+    Value *constants = NULL;
+    if (valid) {
+        constants = (Value*)(base + header->constants);
+        intptr_t delta = (intptr_t)((uintptr_t)base - SNAPSHOT_BASE);
+        for (uint32_t i = 0; valid && i < header->constantCount; i++)
+            valid = relocate(snapshot, &constants[i], delta);
+    }
+
+    if (!valid) {
+        fprintf(stderr, "Invalid snapshot \"%s\".\n", path);
+        munmap(snapshot->base, snapshot->size);
+        return false;
+    }
+
+    Chunk *chunk = &snapshot->chunk;
+    initChunk(chunk);
+    chunk->count = header->codeCount;
+    chunk->capacity = header->codeCount;
+    chunk->code = base + header->code;
+    chunk->lines = (int*)(base + header->lines);
+    chunk->constants.count = header->constantCount;
+    chunk->constants.capacity = header->constantCount;
+    chunk->constants.values = constants;
+
+    const char *problem = verifyChunk(chunk);
+    if (problem != NULL) {
+        fprintf(stderr, "Invalid snapshot \"%s\": %s\n", path, problem);
+        munmap(snapshot->base, snapshot->size);
+        return false;
+    }
+
+    return true;
+}
+
+void freeSnapshot(Snapshot *snapshot) {
+    munmap(snapshot->base, snapshot->size);
+    snapshot->base = NULL;
+    snapshot->size = 0;
+}
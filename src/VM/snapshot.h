@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Chunk/chunk.h"
+#include "common.h"
+
+// A compiled chunk and every object its constants reach, mapped from a
+// file instead of compiled. Files are specific to the build and host
+// that wrote them.
+typedef struct {
+    Chunk chunk; // Points into the mapping, never pass it to freeChunk
+    void *base;
+    size_t size;
+} Snapshot;
+
+// Writes chunk, as quickened so far, and its constants to path
+bool saveSnapshot(Chunk *chunk, const char *path);
+// Maps path copy-on-write, relocating pointers only when the preferred
+// address was taken
+bool loadSnapshot(const char *path, Snapshot *snapshot);
+void freeSnapshot(Snapshot *snapshot);
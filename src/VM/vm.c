@@ -1,24 +1,38 @@
+#include "Core/array.h"
 #include "Core/memory.h"
+#include "Core/metrics.h"
 #include "Core/object.h"
+#include "Core/sequence.h"
 #include "common.h"
 #include "Frontend/compiler.h"
 #include "Chunk/chunk.h"
+#include "Chunk/verify.h"
 #include "Core/value.h"
 #include "Debug/debug.h"
 #include "vm.h"
+#include "jit.h"
 
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+
+// Instructions between wall-clock checks under a time budget
+#define DEADLINE_CHECK_INTERVAL 1024
 
 VM vm;
 
-static void resetStack() {
+void resetStack() {
+    vm.stackBase = vm.stack;
     vm.stackTop = vm.stack;
 }
 
 static void runtimeError(const char *format, ...) {
+    // Whatever printed before the error comes out first
+    flushOutput();
+    COUNT_METRIC(runtimeErrors, 1);
+
     // Handle variable number of args
     va_list args;
     va_start(args, format);
@@ -30,16 +44,57 @@ static void runtimeError(const char *format, ...) {
     int line = vm.chunk->lines[instruction];
     fprintf(stderr, "[line %d] in script\n", line);
 
+    if (vm.trace != NULL && !dumpTrace(vm.trace))
+        fprintf(stderr, "Could not write trace \"%s\".\n", vm.trace->path);
+
     resetStack();
 }
 
+// Turns a latched heap limit overrun into a runtime error
+static bool checkHeapLimit() {
+    if (!vm.memory.limitExceeded) return true;
+
+    runtimeError("Heap limit of %zu bytes exceeded.", vm.memory.maxBytes);
+    return false;
+}
+
 void initVM() {
     resetStack();
-    vm.objects = NULL;
+    initHeap(&vm.heap);
+    vm.jitEnabled = false;
+    vm.memory = (MemoryStats){0};
+    initOutput(&vm.output, OUTPUT_BUFFER_DEFAULT);
+    initScheduler(&vm.scheduler);
+    vm.instructionBudget = 0;
+    vm.timeBudget = 0;
+    vm.suspended = NULL;
+    vm.trace = NULL;
+    vm.chunkId = 0;
+    vm.chunksLoaded = 0;
+}
+
+static void dropSuspended() {
+    if (vm.suspended == NULL) return;
+
+    freeFiber(vm.suspended);
+    vm.suspended = NULL;
 }
 
 void freeVM() {
+    dropSuspended();
+    if (vm.trace != NULL) freeTraceRing(vm.trace);
+    vm.trace = NULL;
+    freeScheduler(&vm.scheduler);
+    freeOutput(&vm.output);
+    freeObjects();
+    // Last, so the final counts include everything freed above
+    closeMetrics();
+}
+
+void resetVM() {
+    dropSuspended();
     freeObjects();
+    resetStack();
 }
 
 void push(Value value) {
@@ -53,51 +108,222 @@ Value pop() {
     return *vm.stackTop;
 }
 
-static Value peek(int distance) {
-    return vm.stackTop[-1 - distance];
-}
-
 static bool isFalsey(Value value) {
     return IS_NIL(value) || (IS_BOOL(value) && !AS_BOOL(value));
 }
 
-static void concatenate() {
-    ObjString *b = AS_STRING(pop());
-    ObjString *a = AS_STRING(pop());
+static Value negate(Value value) {
+    // -0 and -INT64_MIN are only representable as doubles
+    if (IS_INT(value) && AS_INT(value) != 0 && AS_INT(value) != INT64_MIN)
+        return MAKE_INT_VAL(-AS_INT(value));
 
-    int length = a->length + b->length;
-    char *chars = ALLOCATE(char, length + 1); // + 1 for '\0'
-    memcpy(chars, a->chars, a->length);
-    memcpy(chars + a->length, b->chars, b->length);
-    chars[length] = '\0';
+    return MAKE_NUMBER_VAL(-AS_NUMBER(value));
+}
 
-    ObjString *result = takeString(chars, length);
-    push(MAKE_OBJ_VAL(result));
+static Value concatenate(ObjString *a, ObjString *b) {
+    return MAKE_OBJ_VAL(concatenateStrings(a, b));
 }
 
-static InterpretResult run() {
-#define READ_BYTE() (*vm.ip++)
-#define READ_CONSTANT() (vm.chunk->constants.values[READ_BYTE()])
-#define BINARY_OP(valueType, op) \
+// Runs the dispatch loop, or exactly one instruction when singleStep
+// is set, or until vm.sliceRemaining runs out when sliced is set.
+// When instrumented is set, each instruction is recorded to vm.trace if
+// there is one and counted into the metrics page if that is open.
+// Always inlined so run() keeps a branch-free loop.
+//
+// ip, the stack top and the top value itself are kept in locals, so
+// they can stay in registers. The top value's slot in memory is stale
+// until SAVE_REGISTERS() spills it, which happens before anything that
+// reads the VM's registers: runtime errors, tracing and returning.
+static inline __attribute__((always_inline))
+InterpretResult execute(bool singleStep, bool sliced, bool instrumented) {
+    TraceRing *trace = vm.trace;
+    uint16_t chunkId = vm.chunkId;
+    uint8_t *code = vm.chunk->code;
+    bool frozen = vm.chunk->frozen;
+    Value *base = vm.stackBase;
+    Value *constants = vm.chunk->constants.values;
+    uint8_t *ip = vm.ip;
+    Value *sp = vm.stackTop;
+    Value top = sp > base ? sp[-1] : MAKE_NIL_VAL;
+    int remaining = vm.sliceRemaining;
+    uint64_t executed = 0; // Not yet added to the metrics
+
+#define SAVE_REGISTERS() \
     do { \
-        if (!IS_NUMBER(peek(0)) || !IS_NUMBER(peek(1))) { \
-            runtimeError("Operands must be numbers."); \
+        if (sp > base) sp[-1] = top; \
+        vm.ip = ip; \
+        vm.stackTop = sp; \
+        vm.sliceRemaining = remaining; \
+        if (instrumented) { \
+            COUNT_METRIC(instructions, executed); \
+            executed = 0; \
+        } \
+    } while (false)
+#define READ_BYTE() (*ip++)
+#define READ_CONSTANT() (constants[READ_BYTE()])
+// The old top is spilled before value is read, as it may be its slot
+#define PUSH(value) \
+    do { \
+        if (sp > base) sp[-1] = top; \
+        top = (value); \
+        sp++; \
+    } while (false)
+// Replaces the two topmost values, sp[-2] and top, with value
+#define REPLACE_TWO(value) \
+    do { \
+        top = (value); \
+        sp--; \
+    } while (false)
+#define RUNTIME_ERROR(...) \
+    do { \
+        SAVE_REGISTERS(); \
+        runtimeError(__VA_ARGS__); \
+        return INTERPRET_RUNTIME_ERROR; \
+    } while (false)
+#define CHECK_HEAP_LIMIT() \
+    do { \
+        if (vm.memory.limitExceeded) { \
+            SAVE_REGISTERS(); \
+            checkHeapLimit(); \
             return INTERPRET_RUNTIME_ERROR; \
         } \
-        double b = AS_NUMBER(pop()); \
-        double a = AS_NUMBER(pop()); \
-        push(valueType(a op b)); \
+    } while (false)
+#define BINARY_OP(valueType, op) \
+    do { \
+        if (!IS_NUMBER(top) || !IS_NUMBER(sp[-2])) \
+            RUNTIME_ERROR("Operands must be numbers."); \
+        REPLACE_TWO(valueType(AS_NUMBER(sp[-2]) op AS_NUMBER(top))); \
+    } while (false)
+// Rewrites the current instruction to a specialized variant, unless
+// other VMs may be running the chunk too
+#define QUICKEN(op) \
+    do { \
+        if (!frozen) ip[-1] = (op); \
+    } while (false)
+// Guard failed: restore the generic opcode and dispatch it again
+#define DEOPTIMIZE(generic) \
+    do { \
+        ip[-1] = (generic); \
+        ip--; \
+    } while (false)
+// Int-int fast path; overflow falls back to double arithmetic
+#define INT_BINARY_OP(checkedOp, op, intOp, doubleOp) \
+    do { \
+        int64_t result; \
+        if (IS_INT(top) && IS_INT(sp[-2])) { \
+            if (!checkedOp(AS_INT(sp[-2]), AS_INT(top), &result)) { \
+                QUICKEN(intOp); \
+                REPLACE_TWO(MAKE_INT_VAL(result)); \
+                break; \
+            } \
+        } \
+        else if (IS_DOUBLE(top) && IS_DOUBLE(sp[-2])) { \
+            QUICKEN(doubleOp); \
+        } \
+        BINARY_OP(MAKE_NUMBER_VAL, op); \
+    } while (false)
+#define COMPARE_OP(op, intOp, doubleOp) \
+    do { \
+        if (IS_INT(top) && IS_INT(sp[-2])) { \
+            QUICKEN(intOp); \
+            REPLACE_TWO(MAKE_BOOL_VAL(AS_INT(sp[-2]) op AS_INT(top))); \
+            break; \
+        } \
+        if (IS_DOUBLE(top) && IS_DOUBLE(sp[-2])) { \
+            QUICKEN(doubleOp); \
+        } \
+        BINARY_OP(MAKE_BOOL_VAL, op); \
+    } while (false)
+// Quickened int-int op, deoptimizes on type mismatch or overflow
+#define QUICK_INT_OP(checkedOp, generic) \
+    do { \
+        int64_t result; \
+        if (!IS_INT(top) || !IS_INT(sp[-2]) || \
+            checkedOp(AS_INT(sp[-2]), AS_INT(top), &result)) \
+        { \
+            DEOPTIMIZE(generic); \
+            break; \
+        } \
+        REPLACE_TWO(MAKE_INT_VAL(result)); \
+    } while (false)
+#define QUICK_INT_COMPARE(op, generic) \
+    do { \
+        if (!IS_INT(top) || !IS_INT(sp[-2])) { \
+            DEOPTIMIZE(generic); \
+            break; \
+        } \
+        REPLACE_TWO(MAKE_BOOL_VAL(AS_INT(sp[-2]) op AS_INT(top))); \
+    } while (false)
+// Quickened double-double op, deoptimizes on type mismatch
+#define QUICK_DOUBLE_OP(valueType, op, generic) \
+    do { \
+        if (!IS_DOUBLE(top) || !IS_DOUBLE(sp[-2])) { \
+            DEOPTIMIZE(generic); \
+            break; \
+        } \
+        REPLACE_TWO(valueType(AS_DOUBLE(sp[-2]) op AS_DOUBLE(top))); \
+    } while (false)
+// Array operations from Core/array.c report errors as messages; one
+// refused for the heap limit reports it as the VM's limit error
+#define ARRAY_UNARY(function) \
+    do { \
+        Value result; \
+        const char *error = function(top, &result); \
+        if (error != NULL) { \
+            CHECK_HEAP_LIMIT(); \
+            RUNTIME_ERROR("%s", error); \
+        } \
+        top = result; \
+        CHECK_HEAP_LIMIT(); \
+    } while (false)
+#define ARRAY_BINARY(function) \
+    do { \
+        Value result; \
+        const char *error = function(sp[-2], top, &result); \
+        if (error != NULL) { \
+            CHECK_HEAP_LIMIT(); \
+            RUNTIME_ERROR("%s", error); \
+        } \
+        REPLACE_TWO(result); \
+        CHECK_HEAP_LIMIT(); \
+    } while (false)
+// Operands the compiler proved numeric, only the representation varies
+#define NUMBER_OP(checkedOp, op) \
+    do { \
+        int64_t result; \
+        Value a = sp[-2]; \
+        if (IS_INT(a) && IS_INT(top) && \
+            !checkedOp(AS_INT(a), AS_INT(top), &result)) \
+        { \
+            REPLACE_TWO(MAKE_INT_VAL(result)); \
+        } \
+        else { \
+            REPLACE_TWO(MAKE_NUMBER_VAL(AS_NUMBER(a) op AS_NUMBER(top))); \
+        } \
+    } while (false)
+#define NUMBER_COMPARE(op) \
+    do { \
+        Value a = sp[-2]; \
+        REPLACE_TWO(MAKE_BOOL_VAL(IS_INT(a) && IS_INT(top) \
+            ? AS_INT(a) op AS_INT(top) \
+            : AS_NUMBER(a) op AS_NUMBER(top))); \
     } while (false)
 
     for(;;) {
+        if (sliced && remaining-- == 0) {
+            SAVE_REGISTERS();
+            return INTERPRET_YIELD;
+        }
+
 #ifdef DEBUG_TRACE_EXECUTION
-        printf("        ");
-        for(Value *slot = vm.stack; slot < vm.stackTop; slot++) {
-            printf("[");
+        SAVE_REGISTERS();
+        printOutput("        ");
+        for(Value *slot = vm.stackBase; slot < vm.stackTop; slot++) {
+            printOutput("[");
             printValue(*slot);
-            printf("] ");
+            printOutput("] ");
         }
-        printf("\n");
+        printOutput("\n");
 
         // > [!WARNING]: 
         // Something's wrong with this
@@ -109,75 +335,300 @@ static InterpretResult run() {
             (int)(vm.ip - vm.chunk->code));
 #endif
 
+        if (instrumented) {
+            if (trace != NULL)
+                recordTrace(trace, chunkId, (uint32_t)(ip - code), *ip,
+                            (int)(sp - base));
+            executed++;
+        }
+
+        uint8_t *instructionStart = ip;
         uint8_t instruction = READ_BYTE();
         switch (instruction) {
-            case OP_CONSTANT: {
-                Value constant = READ_CONSTANT();
-                push(constant);
+            case OP_CONSTANT: PUSH(READ_CONSTANT()); break;
+            case OP_NIL: PUSH(MAKE_NIL_VAL); break;
+            case OP_TRUE: PUSH(MAKE_BOOL_VAL(true)); break;
+            case OP_FALSE: PUSH(MAKE_BOOL_VAL(false)); break;
+            case OP_EQUAL:
+                REPLACE_TWO(MAKE_BOOL_VAL(valuesEqual(sp[-2], top)));
                 break;
-            }
-            case OP_NIL: push(MAKE_NIL_VAL); break;
-            case OP_TRUE: push(MAKE_BOOL_VAL(true)); break;
-            case OP_FALSE: push(MAKE_BOOL_VAL(false)); break;
-            case OP_EQUAL: {
-                Value b = pop();
-                Value a = pop();
-                push(MAKE_BOOL_VAL(valuesEqual(a, b))); 
+            case OP_GREATER:
+                COMPARE_OP(>, OP_GREATER_INT, OP_GREATER_NUM);
+                break;
+            case OP_LESS:
+                COMPARE_OP(<, OP_LESS_INT, OP_LESS_NUM);
                 break;
-            }
-            case OP_GREATER: BINARY_OP(MAKE_BOOL_VAL, >); break;
-            case OP_LESS: BINARY_OP(MAKE_BOOL_VAL, <); break;
             case OP_ADD: {
-                if (IS_STRING(peek(0)) && IS_STRING(peek(1))) {
-                    concatenate();
+                int64_t result;
+                if (IS_INT(top) && IS_INT(sp[-2]) &&
+                    !__builtin_add_overflow(
+                        AS_INT(sp[-2]), AS_INT(top), &result))
+                {
+                    QUICKEN(OP_ADD_INT);
+                    REPLACE_TWO(MAKE_INT_VAL(result));
+                }
+                else if (IS_STRING(top) && IS_STRING(sp[-2])) {
+                    QUICKEN(OP_ADD_STR);
+                    REPLACE_TWO(concatenate(AS_STRING(sp[-2]),
+                                            AS_STRING(top)));
+                    CHECK_HEAP_LIMIT();
+                }
+                else if (IS_NUMBER(top) && IS_NUMBER(sp[-2])) {
+                    if (IS_DOUBLE(top) && IS_DOUBLE(sp[-2]))
+                        QUICKEN(OP_ADD_NUM);
+
+                    REPLACE_TWO(MAKE_NUMBER_VAL(
+                        AS_NUMBER(sp[-2]) + AS_NUMBER(top)));
                 }
-                else if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1))) {
-                    double b = AS_NUMBER(pop());
-                    double a = AS_NUMBER(pop());
-                    push(MAKE_NUMBER_VAL(a + b));
+                else if (isArrayArithmetic(sp[-2], top)) {
+                    ARRAY_BINARY(arrayAdd);
                 }
                 else {
-                    runtimeError(
+                    RUNTIME_ERROR(
                         "Operands must be two numbers or two strings."
                     );
-
-                    return INTERPRET_RUNTIME_ERROR;
                 }
 
                 break;
             }
-            case OP_SUBTRACT: BINARY_OP(MAKE_NUMBER_VAL, -); break;
-            case OP_MULTIPLY: BINARY_OP(MAKE_NUMBER_VAL, *); break;
-            case OP_DIVIDE: BINARY_OP(MAKE_NUMBER_VAL, /); break;
-            case OP_NOT: 
-                push(MAKE_BOOL_VAL(isFalsey(pop())));
+            case OP_SUBTRACT:
+                INT_BINARY_OP(__builtin_sub_overflow, -,
+                              OP_SUBTRACT_INT, OP_SUBTRACT_NUM);
                 break;
-            case OP_NEGATE: {
-                if (!IS_NUMBER(peek(0))) {
-                    runtimeError("Operand must be a number.");
-
-                    return INTERPRET_RUNTIME_ERROR;
+            case OP_MULTIPLY:
+                if (isArrayArithmetic(sp[-2], top)) {
+                    ARRAY_BINARY(arrayMultiply);
+                    break;
                 }
+                INT_BINARY_OP(intMultiplyOverflow, *,
+                              OP_MULTIPLY_INT, OP_MULTIPLY_NUM);
+                break;
+            // Division always yields a double, as in plain Lox
+            case OP_DIVIDE:
+                if (IS_DOUBLE(top) && IS_DOUBLE(sp[-2]))
+                    QUICKEN(OP_DIVIDE_NUM);
+                BINARY_OP(MAKE_NUMBER_VAL, /);
+                break;
+            case OP_NOT: 
+                top = MAKE_BOOL_VAL(isFalsey(top));
+                break;
+            case OP_NEGATE:
+                if (!IS_NUMBER(top))
+                    RUNTIME_ERROR("Operand must be a number.");
 
-                push(MAKE_NUMBER_VAL(-AS_NUMBER(pop())));
+                top = negate(top);
+                break;
+            case OP_SUM: ARRAY_UNARY(arraySum); break;
+            case OP_DOT: ARRAY_BINARY(arrayDot); break;
+            case OP_MIN: ARRAY_UNARY(arrayMin); break;
+            case OP_MAX: ARRAY_UNARY(arrayMax); break;
+            case OP_RANGE: ARRAY_UNARY(arrayRange); break;
+            case OP_LENGTH: ARRAY_UNARY(sequenceLength); break;
+            case OP_INDEX: ARRAY_BINARY(sequenceIndex); break;
+            case OP_ADD_NN:
+                NUMBER_OP(__builtin_add_overflow, +);
+                break;
+            case OP_SUBTRACT_NN:
+                NUMBER_OP(__builtin_sub_overflow, -);
+                break;
+            case OP_MULTIPLY_NN:
+                NUMBER_OP(intMultiplyOverflow, *);
+                break;
+            case OP_DIVIDE_NN:
+                REPLACE_TWO(MAKE_NUMBER_VAL(
+                    AS_NUMBER(sp[-2]) / AS_NUMBER(top)));
+                break;
+            case OP_LESS_NN: NUMBER_COMPARE(<); break;
+            case OP_GREATER_NN: NUMBER_COMPARE(>); break;
+            case OP_NEGATE_N:
+                top = negate(top);
+                break;
+            case OP_CONCAT:
+                REPLACE_TWO(concatenate(AS_STRING(sp[-2]), AS_STRING(top)));
+                CHECK_HEAP_LIMIT();
+                break;
+            case OP_GET_LOCAL: {
+                uint8_t slot = READ_BYTE();
+                PUSH(base[slot]);
                 break;
             }
+            case OP_SET_LOCAL: {
+                uint8_t slot = READ_BYTE();
+                base[slot] = top;
+                break;
+            }
+            case OP_COLUMN:
+                RUNTIME_ERROR("Columns are only bound in batch evaluation.");
+            case OP_ADD_INT:
+                QUICK_INT_OP(__builtin_add_overflow, OP_ADD);
+                break;
+            case OP_ADD_NUM:
+                QUICK_DOUBLE_OP(MAKE_NUMBER_VAL, +, OP_ADD);
+                break;
+            case OP_ADD_STR:
+                if (!IS_STRING(top) || !IS_STRING(sp[-2])) {
+                    DEOPTIMIZE(OP_ADD);
+                    break;
+                }
+                REPLACE_TWO(concatenate(AS_STRING(sp[-2]), AS_STRING(top)));
+                CHECK_HEAP_LIMIT();
+                break;
+            case OP_SUBTRACT_INT:
+                QUICK_INT_OP(__builtin_sub_overflow, OP_SUBTRACT);
+                break;
+            case OP_SUBTRACT_NUM:
+                QUICK_DOUBLE_OP(MAKE_NUMBER_VAL, -, OP_SUBTRACT);
+                break;
+            case OP_MULTIPLY_INT:
+                QUICK_INT_OP(intMultiplyOverflow, OP_MULTIPLY);
+                break;
+            case OP_MULTIPLY_NUM:
+                QUICK_DOUBLE_OP(MAKE_NUMBER_VAL, *, OP_MULTIPLY);
+                break;
+            case OP_DIVIDE_NUM:
+                QUICK_DOUBLE_OP(MAKE_NUMBER_VAL, /, OP_DIVIDE);
+                break;
+            case OP_LESS_INT: QUICK_INT_COMPARE(<, OP_LESS); break;
+            case OP_LESS_NUM:
+                QUICK_DOUBLE_OP(MAKE_BOOL_VAL, <, OP_LESS);
+                break;
+            case OP_GREATER_INT: QUICK_INT_COMPARE(>, OP_GREATER); break;
+            case OP_GREATER_NUM:
+                QUICK_DOUBLE_OP(MAKE_BOOL_VAL, >, OP_GREATER);
+                break;
             case OP_RETURN: {
-                printValue(pop());
-                printf("\n");
+                Value result = top;
+                sp--;
+                // Reserved slots may still be below the result
+                if (sp > base) top = sp[-1];
+                SAVE_REGISTERS();
+
+                printValue(result);
+                writeOutput("\n", 1);
                 return INTERPRET_OK;
             }
         }
+
+        // A deoptimized instruction rewinds ip and still has to run
+        if (singleStep && ip != instructionStart) {
+            SAVE_REGISTERS();
+            return INTERPRET_OK;
+        }
     }
 
+    #undef SAVE_REGISTERS
     #undef READ_BYTE
     #undef READ_CONSTANT
+    #undef PUSH
+    #undef REPLACE_TWO
+    #undef RUNTIME_ERROR
+    #undef CHECK_HEAP_LIMIT
     #undef BINARY_OP
+    #undef QUICKEN
+    #undef DEOPTIMIZE
+    #undef INT_BINARY_OP
+    #undef COMPARE_OP
+    #undef QUICK_INT_OP
+    #undef QUICK_INT_COMPARE
+    #undef QUICK_DOUBLE_OP
+    #undef ARRAY_UNARY
+    #undef ARRAY_BINARY
+    #undef NUMBER_OP
+    #undef NUMBER_COMPARE
+}
+
+// Recording and counting get their own copy of the loop so the plain
+// one pays nothing
+static InterpretResult run() {
+    if (vm.trace != NULL || metrics != NULL)
+        return execute(false, false, true);
+
+    return execute(false, false, false);
+}
+
+// Instructions the JIT runs natively are not recorded either way
+InterpretResult stepInstruction(uint8_t *ip) {
+    vm.ip = ip;
+
+    return execute(true, false, false);
+}
+
+// Already counting every instruction, one more check costs little
+InterpretResult runSlice(int instructions) {
+    vm.sliceRemaining = instructions;
+
+    return execute(false, true, true);
+}
+
+static long long now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (long long)time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+// Runs vm.suspended until it finishes or this call's budget runs out.
+// Code is straight-line, so the clock is read every so many
+// instructions rather than at backward jumps.
+static InterpretResult runBudgeted() {
+    long long deadline = vm.timeBudget > 0 ? now() + vm.timeBudget : 0;
+    long remaining = vm.instructionBudget;
+
+    for (;;) {
+        int slice = DEADLINE_CHECK_INTERVAL;
+        if (vm.instructionBudget > 0 && remaining < slice)
+            slice = (int)remaining;
+
+        InterpretResult result = runFiber(vm.suspended, slice);
+        if (result != INTERPRET_YIELD) {
+            dropSuspended();
+            return result;
+        }
+
+        remaining -= slice;
+        if (vm.instructionBudget > 0 && remaining == 0) return result;
+        if (deadline != 0 && now() >= deadline) return result;
+    }
+}
+
+// Compiles into a fiber so the script survives running out of budget
+static InterpretResult interpretBudgeted(const char *source) {
+    dropSuspended();
+    clearHeapLimit();
+
+    vm.suspended = newFiber(source);
+    if (vm.suspended == NULL) return INTERPRET_COMPILE_ERROR;
+
+    if (vm.memory.limitExceeded) {
+        fprintf(stderr, "Heap limit of %zu bytes exceeded while compiling.\n",
+                vm.memory.maxBytes);
+        dropSuspended();
+
+        return INTERPRET_RUNTIME_ERROR;
+    }
+
+    return runBudgeted();
+}
+
+InterpretResult resumeInterpret() {
+    if (vm.suspended == NULL) {
+        fprintf(stderr, "No suspended script to resume.\n");
+
+        return INTERPRET_RUNTIME_ERROR;
+    }
+
+    clearHeapLimit();
+    return runBudgeted();
 }
 
 InterpretResult interpret(const char *source) {
+    // The JIT runs to completion, so budgeted scripts are interpreted
+    if (vm.instructionBudget > 0 || vm.timeBudget > 0)
+        return interpretBudgeted(source);
+
     Chunk chunk;
     initChunk(&chunk);
+    clearHeapLimit();
 
     if (!compile(source, &chunk)) {
         freeChunk(&chunk);
@@ -185,11 +636,58 @@ InterpretResult interpret(const char *source) {
         return INTERPRET_COMPILE_ERROR;
     }
 
-    vm.chunk = &chunk;
-    vm.ip = vm.chunk->code;
+    if (vm.memory.limitExceeded) {
+        fprintf(stderr, "Heap limit of %zu bytes exceeded while compiling.\n",
+                vm.memory.maxBytes);
+        freeChunk(&chunk);
 
-    InterpretResult result = run();
+        return INTERPRET_RUNTIME_ERROR;
+    }
 
+    InterpretResult result = interpretChunk(&chunk);
     freeChunk(&chunk);
+
+    return result;
+}
+
+InterpretResult interpretChunk(Chunk *chunk) {
+    // Compiled and loaded chunks were verified already
+    if (chunk->stackDepth == 0) {
+        const char *problem = verifyChunk(chunk);
+        if (problem != NULL) {
+            fprintf(stderr, "Invalid bytecode: %s\n", problem);
+            return INTERPRET_COMPILE_ERROR;
+        }
+    }
+
+    // The stack is reserved for the chunk's full depth up front, so
+    // run() never checks for overflow. Deeper chunks than vm.stack
+    // holds get one of their own and are interpreted, since the JIT
+    // addresses vm.stack directly.
+    Value *stack = NULL;
+    if (chunk->stackDepth > STACK_MAX) {
+        stack = ALLOCATE(Value, chunk->stackDepth, MEM_STACKS);
+        vm.stackBase = stack;
+        vm.stackTop = stack;
+    }
+
+    vm.chunk = chunk;
+    vm.chunkId = vm.chunksLoaded++;
+    vm.ip = vm.chunk->code;
+
+    InterpretResult result;
+    JitCode code;
+    if (vm.jitEnabled && stack == NULL && jitCompile(chunk, &code)) {
+        result = jitRun(&code);
+        jitFree(&code);
+    }
+    else {
+        result = run();
+    }
+    // Slots reserved for shared results outlive OP_RETURN
+    resetStack();
+    if (stack != NULL)
+        FREE_ARRAY(Value, stack, chunk->stackDepth, MEM_STACKS);
+
     return result;
 }
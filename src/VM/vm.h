@@ -1,7 +1,12 @@
 #pragma once
 
 #include "Chunk/chunk.h"
+#include "Core/heap.h"
+#include "Core/memory.h"
+#include "Core/output.h"
 #include "Core/value.h"
+#include "Debug/trace.h"
+#include "fiber.h"
 
 #define STACK_MAX 256
 
@@ -9,20 +14,50 @@ typedef struct {
     Chunk *chunk;
     uint8_t* ip; // Instruction Pointer
     Value stack[STACK_MAX];
+    Value* stackBase; // vm.stack, or the running fiber's stack
     Value* stackTop;
-    Obj* objects;
+    int sliceRemaining; // Instructions left in the current slice
+    ObjectHeap heap;
+    bool jitEnabled; // Try the baseline JIT before interpreting
+    MemoryStats memory; // Heap accounting and limit
+    Output output; // Buffered program output
+    Scheduler scheduler; // Fibers waiting for a turn
+    // Per interpret() or resumeInterpret() call, 0 when unlimited
+    long instructionBudget;
+    long long timeBudget; // Nanoseconds
+    Fiber *suspended; // Script that ran out of budget
+    TraceRing *trace; // Execution recorder, NULL when off
+    uint16_t chunkId; // Of vm.chunk, for trace records
+    uint16_t chunksLoaded;
 } VM;
 
 typedef enum {
     INTERPRET_OK,
     INTERPRET_COMPILE_ERROR,
-    INTERPRET_RUNTIME_ERROR
+    INTERPRET_RUNTIME_ERROR,
+    INTERPRET_YIELD // Out of slice or budget, the script can resume
 } InterpretResult;
 
 extern VM vm;
 
 void initVM();
 void freeVM();
+// Drops all objects and stack state but keeps VM configuration
+void resetVM();
+// Points the VM back at its own, empty stack
+void resetStack();
 InterpretResult interpret(const char *source);
+// Runs an already compiled chunk to completion, leaving it quickened;
+// budgets do not apply
+InterpretResult interpretChunk(Chunk *chunk);
+// Executes the single instruction at ip; the JIT's slow path
+InterpretResult stepInstruction(uint8_t *ip);
+// Runs vm.chunk from vm.ip for at most instructions instructions
+InterpretResult runSlice(int instructions);
+// Same, on fiber's registers, which are saved back afterwards
+InterpretResult runFiber(Fiber *fiber, int instructions);
+// Continues a script interpret() left at INTERPRET_YIELD, under a
+// fresh budget
+InterpretResult resumeInterpret();
 void push(Value value);
 Value pop();
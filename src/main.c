@@ -1,22 +1,36 @@
 #include "common.h"
+#include "Backend/cgen.h"
+#include "Chunk/frozen.h"
+#include "Core/memory.h"
+#include "Core/metrics.h"
+#include "Core/output.h"
+#include "Debug/trace.h"
+#include "Frontend/bulk.h"
+#include "Frontend/compiler.h"
+#include "Server/server.h"
+#include "VM/batch.h"
+#include "VM/snapshot.h"
 #include "VM/vm.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 static void repl() {
     char line[1024];
-    printf("Welcome to Clox: \n");
+    printOutput("Welcome to Clox: \n");
     while(true) {
-        printf(">> ");
+        printOutput(">> ");
+        flushOutput();
 
         if (!fgets(line, sizeof(line), stdin)) {
-            printf("\n");
+            printOutput("\n");
             break;
         }
         
-        interpret(line);
+        InterpretResult result = interpret(line);
+        while (result == INTERPRET_YIELD) result = resumeInterpret();
     }
 }
 
@@ -47,11 +61,27 @@ static char* readFile(const char *path) {
     return buffer;
 }
 
+// Wraps a script so its string literals can view it; the caller holds
+// the first reference
+static SourceBuffer *readSource(const char *path) {
+    char *chars = readFile(path);
+
+    return newSourceBuffer(chars, (int)strlen(chars));
+}
+
 static void executeFile(const char *path) {
-    char *source = readFile(path);
+    SourceBuffer *source = readSource(path);
 
-    InterpretResult result = interpret(source);
-    free(source);
+    setSourceBuffer(source);
+    InterpretResult result = interpret(source->chars);
+    setSourceBuffer(NULL);
+    // Literals keep the text alive for as long as they need it
+    releaseSource(source);
+
+    // A budgeted script hands control back between slices; a host
+    // would run other work here before resuming it
+    while (result == INTERPRET_YIELD) result = resumeInterpret();
+    flushOutput();
 
     if (result == INTERPRET_COMPILE_ERROR) 
         exit (65); // Data error
@@ -59,20 +89,331 @@ static void executeFile(const char *path) {
         exit (70);
 }
 
+// Runs count copies of the script as interleaved fibers, all sharing
+// one frozen chunk
+static void executeFibers(const char *path, int count) {
+    SourceBuffer *source = readSource(path);
+
+    setSourceBuffer(source);
+    Chunk *chunk = compileFrozen(source->chars);
+    setSourceBuffer(NULL);
+    releaseSource(source);
+    if (chunk == NULL) exit(65); // Data error
+
+    for (int i = 0; i < count; i++)
+        spawnFiber(chunk);
+
+    int failures = runFibers();
+    flushOutput();
+    freeFrozenChunks();
+
+    if (failures > 0) exit(70);
+}
+
+// Evaluates path once per row of a CSV file, whose header names the
+// columns the script can read
+static void executeBatch(const char *path, const char *csvPath, int jobs) {
+    char *text = readFile(csvPath);
+    BatchTable table;
+    const char *error = parseCsv(text, &table);
+    free(text);
+    if (error != NULL) {
+        fprintf(stderr, "Invalid CSV file \"%s\": %s\n", csvPath, error);
+        exit(65); // Data error
+    }
+
+    char *source = readFile(path);
+    Chunk chunk;
+    initChunk(&chunk);
+    bool compiled = compileColumns(source, (const char**)table.names,
+                                   table.columnCount, &chunk);
+    free(source);
+    if (!compiled) exit(65);
+
+    BatchResult result;
+    evaluateBatch(&chunk, table.columns, table.rows, jobs, &result);
+
+    // Failed rows keep their line so output stays aligned with input
+    for (int row = 0; row < result.rows; row++) {
+        if (result.errors[row] != NULL) {
+            printOutput("error: %s\n", result.errors[row]);
+        }
+        else {
+            printValue(result.values[row]);
+            printOutput("\n");
+        }
+    }
+    flushOutput();
+
+    int failures = result.failures;
+    freeBatchResult(&result);
+    freeChunk(&chunk);
+    freeBatchTable(&table);
+
+    if (failures > 0) exit(70);
+}
+
+// Compiles path ahead of time into a C translation unit at outPath
+static void emitFile(const char *path, const char *outPath) {
+    char *source = readFile(path);
+
+    Chunk chunk;
+    initChunk(&chunk);
+    if (!compile(source, &chunk))
+        exit(65); // Data error
+
+    FILE *out = fopen(outPath, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Could not open file \"%s\".\n", outPath);
+        exit(74); // I/0 error
+    }
+
+    bool emitted = emitC(&chunk, path, out);
+    fclose(out);
+    freeChunk(&chunk);
+    free(source);
+
+    if (!emitted)
+        exit(65);
+}
+
+// Runs path once as warm-up, then snapshots its quickened chunk
+static void snapshotFile(const char *path, const char *snapshotPath) {
+    char *source = readFile(path);
+
+    Chunk chunk;
+    initChunk(&chunk);
+    if (!compile(source, &chunk))
+        exit(65); // Data error
+
+    InterpretResult result = interpretChunk(&chunk);
+    flushOutput();
+    if (result == INTERPRET_RUNTIME_ERROR)
+        exit(70);
+
+    if (!saveSnapshot(&chunk, snapshotPath))
+        exit(74); // I/0 error
+
+    freeChunk(&chunk);
+    free(source);
+}
+
+// Runs a snapshot in place of compiling its script
+static void executeSnapshot(const char *snapshotPath) {
+    Snapshot snapshot;
+    if (!loadSnapshot(snapshotPath, &snapshot))
+        exit(74); // I/0 error
+
+    InterpretResult result = interpretChunk(&snapshot.chunk);
+    flushOutput();
+    freeSnapshot(&snapshot);
+
+    if (result == INTERPRET_RUNTIME_ERROR)
+        exit(70);
+}
+
+// Parses a byte count with an optional k/m/g suffix, 0 when invalid
+static size_t parseSize(const char *text) {
+    char *end;
+    unsigned long long size = strtoull(text, &end, 10);
+
+    switch (*end) {
+        case 'k': case 'K': size <<= 10; end++; break;
+        case 'm': case 'M': size <<= 20; end++; break;
+        case 'g': case 'G': size <<= 30; end++; break;
+    }
+
+    return *end == '\0' ? (size_t)size : 0;
+}
+
+static bool heapStats = false;
+
+// Also registered with atexit so the report covers error exits
+static void reportHeap() {
+    if (!heapStats) return;
+
+    heapStats = false;
+    printMemoryStats(stderr);
+}
+
+static void usage() {
+    fprintf(stderr,
+            "Usage: clox [--jit] [--dump-ir] [--max-heap bytes[k|m|g]]\n"
+            "            [--heap-stats] [--output-buffer bytes[k|m|g]]\n"
+            "            [--emit-c out.c] [--fibers N [--slice N]]\n"
+            "            [--budget N] [--deadline ms] [--lex-threads N]\n"
+            "            [--trace-ring N [--trace-file trace.bin]]\n"
+            "            [--metrics file] [path]\n"
+            "       clox [--jit] --save-snapshot out.snap path\n"
+            "       clox [--jit] --snapshot file.snap\n"
+            "       clox --decode-trace trace.bin path\n"
+            "       clox [--jit] --serve socket\n"
+            "       clox --client socket path\n"
+            "       clox --compile-all dir [-j N]\n"
+            "       clox --batch data.csv [-j N] path\n");
+    exit(64); // Command line usage error
+}
+
 int main(int argc, const char* argv[]) {
     initVM();
 
-    if (argc == 1) {
+    const char *path = NULL;
+    const char *emitPath = NULL;
+    const char *servePath = NULL;
+    const char *clientPath = NULL;
+    const char *compileDirectory = NULL;
+    const char *saveSnapshotPath = NULL;
+    const char *snapshotPath = NULL;
+    const char *decodePath = NULL;
+    const char *tracePath = TRACE_FILE_DEFAULT;
+    const char *metricsPath = NULL;
+    const char *batchPath = NULL;
+    int traceRecords = 0;
+    int fibers = 0;
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    atexit(reportHeap);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--jit") == 0) {
+            vm.jitEnabled = true;
+        }
+        else if (strcmp(argv[i], "--max-heap") == 0 && i + 1 < argc) {
+            vm.memory.maxBytes = parseSize(argv[++i]);
+            if (vm.memory.maxBytes == 0) usage();
+        }
+        else if (strcmp(argv[i], "--heap-stats") == 0) {
+            heapStats = true;
+        }
+        else if (strcmp(argv[i], "--output-buffer") == 0 && i + 1 < argc) {
+            // 0 is valid here and leaves output unbuffered
+            size_t capacity = parseSize(argv[++i]);
+            if (capacity == 0 && strcmp(argv[i], "0") != 0) usage();
+            setOutputCapacity(capacity);
+        }
+        else if (strcmp(argv[i], "--fibers") == 0 && i + 1 < argc) {
+            fibers = atoi(argv[++i]);
+            if (fibers < 1) usage();
+        }
+        else if (strcmp(argv[i], "--slice") == 0 && i + 1 < argc) {
+            vm.scheduler.slice = atoi(argv[++i]);
+            if (vm.scheduler.slice < 1) usage();
+        }
+        else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            vm.instructionBudget = atol(argv[++i]);
+            if (vm.instructionBudget < 1) usage();
+        }
+        else if (strcmp(argv[i], "--deadline") == 0 && i + 1 < argc) {
+            vm.timeBudget = atoll(argv[++i]) * 1000000LL;
+            if (vm.timeBudget < 1) usage();
+        }
+        else if (strcmp(argv[i], "--lex-threads") == 0 && i + 1 < argc) {
+            int threads = atoi(argv[++i]);
+            if (threads < 1) usage();
+            setLexThreads(threads);
+        }
+        else if (strcmp(argv[i], "--trace-ring") == 0 && i + 1 < argc) {
+            traceRecords = atoi(argv[++i]);
+            if (traceRecords < 1) usage();
+        }
+        else if (strcmp(argv[i], "--trace-file") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metricsPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--decode-trace") == 0 && i + 1 < argc) {
+            decodePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dump-ir") == 0) {
+            setIrDump(true);
+        }
+        else if (strcmp(argv[i], "--emit-c") == 0 && i + 1 < argc) {
+            emitPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save-snapshot") == 0 && i + 1 < argc) {
+            saveSnapshotPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            snapshotPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            servePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--client") == 0 && i + 1 < argc) {
+            clientPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--compile-all") == 0 && i + 1 < argc) {
+            compileDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+            if (jobs < 1) usage();
+        }
+        else if (path == NULL && argv[i][0] != '-') {
+            path = argv[i];
+        }
+        else {
+            usage();
+        }
+    }
+
+    if (traceRecords > 0)
+        vm.trace = newTraceRing((uint32_t)traceRecords, tracePath);
+    if (metricsPath != NULL && !openMetrics(metricsPath)) {
+        fprintf(stderr, "Could not open file \"%s\".\n", metricsPath);
+        exit(74); // I/0 error
+    }
+
+    if (decodePath != NULL) {
+        if (path == NULL) usage();
+        int status = decodeTrace(decodePath, path);
+        flushOutput();
+        freeVM();
+        return status;
+    }
+    else if (compileDirectory != NULL) {
+        int status = compileAll(compileDirectory, jobs);
+        freeVM();
+        return status;
+    }
+    else if (clientPath != NULL) {
+        if (path == NULL) usage();
+        int status = runClient(clientPath, path);
+        freeVM();
+        return status;
+    }
+    else if (servePath != NULL) {
+        exit(serve(servePath));
+    }
+    else if (batchPath != NULL) {
+        if (path == NULL) usage();
+        executeBatch(path, batchPath, jobs);
+    }
+    else if (emitPath != NULL) {
+        if (path == NULL) usage();
+        emitFile(path, emitPath);
+    }
+    else if (saveSnapshotPath != NULL) {
+        if (path == NULL) usage();
+        snapshotFile(path, saveSnapshotPath);
+    }
+    else if (snapshotPath != NULL) {
+        if (path != NULL) usage();
+        executeSnapshot(snapshotPath);
+    }
+    else if (path == NULL) {
         repl();
     }
-    else if (argc == 2) {
-        executeFile(argv[1]);
+    else if (fibers > 0) {
+        executeFibers(path, fibers);
     }
     else {
-        fprintf(stderr, "Usage: clox [path]\n");
-        exit(64); // Command line usage error
+        executeFile(path);
     }
 
+    reportHeap();
     freeVM();
 
     return 0;